@@ -1,3 +1,6 @@
 #pragma once
 
-#define ENCODER_MAP_KEY_DELAY 2
\ No newline at end of file
+#define ENCODER_MAP_KEY_DELAY 2
+
+// Unique USB serial per board (from the MCU signature row) so several boards can be told apart by the host
+#define SERIAL_NUMBER_USE_HARDWARE_ID TRUE
\ No newline at end of file
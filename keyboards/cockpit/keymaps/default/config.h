@@ -0,0 +1,5 @@
+#pragma once
+
+// EEPROM user datablock holding the custom theme (theme_custom_t in keymap.c):
+// a valid marker, a 16-bit layer mask and one HSV triple for each of the 8 layers
+#define EECONFIG_USER_DATA_SIZE 27
@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""Generates themes.h, the PROGMEM layer color table, from themes.json.
+
+Usage: gen_themes.py themes.json keymap.c themes.h
+
+Layer names are checked against enum cockpit_layer in keymap.c.
+
+The output is only rewritten when its contents change, so running this on
+every build does not force keymap.c to recompile.
+"""
+import json
+import re
+import sys
+
+LAYER_ENUM = re.compile(r'enum\s+cockpit_layer\s*\{(.*?)\}', re.S)
+ENUM_MEMBER = re.compile(r'^\s*(_[A-Z][A-Z0-9_]*)', re.M)
+THEME_NAME = re.compile(r'^[a-z][a-z0-9_]*$')
+
+
+def load_layers(keymap_path):
+    with open(keymap_path, encoding='utf-8') as f:
+        match = LAYER_ENUM.search(f.read())
+    if not match:
+        raise ValueError(f'{keymap_path}: enum cockpit_layer not found')
+    # Drop comments so only the member names are left
+    body = re.sub(r'//[^\n]*|/\*.*?\*/', '', match.group(1), flags=re.S)
+    return ENUM_MEMBER.findall(body)
+
+
+def load_themes(path, layers):
+    with open(path, encoding='utf-8') as f:
+        themes = json.load(f)['themes']
+
+    if not themes:
+        raise ValueError('themes.json defines no themes')
+
+    names = set()
+    for theme in themes:
+        if not THEME_NAME.match(theme['name']):
+            raise ValueError(f'"{theme["name"]}" is not a valid theme name (lowercase letters, digits, _)')
+        if theme['name'] in names:
+            raise ValueError(f'theme "{theme["name"]}" is defined twice')
+        names.add(theme['name'])
+        if not theme['layers']:
+            raise ValueError(f'{theme["name"]}: defines no layer colors')
+        for layer, hsv in theme['layers'].items():
+            if layer not in layers:
+                raise ValueError(f'{theme["name"]}: "{layer}" is not in enum cockpit_layer ({", ".join(layers)})')
+            if len(hsv) != 3 or not all(isinstance(c, int) and 0 <= c <= 255 for c in hsv):
+                raise ValueError(f'{theme["name"]}.{layer}: expected [hue, sat, val] in 0-255')
+    return themes
+
+
+def render(themes):
+    out = [
+        '// Generated by gen_themes.py from themes.json, do not edit',
+        '#pragma once',
+        '',
+        '// Needs enum cockpit_layer and THEME_LAYER_COUNT to be defined before inclusion',
+        '',
+        f'#define THEME_COUNT {len(themes)}',
+        '',
+    ]
+
+    for i, theme in enumerate(themes):
+        out.append(f'#define THEME_{theme["name"].upper()} {i}')
+    out.append('')
+
+    out.append('// Layers each theme sets a color for; others keep the current color')
+    out.append('static const uint16_t PROGMEM theme_layer_mask[THEME_COUNT] = {')
+    for theme in themes:
+        bits = ' | '.join(f'(1 << {layer})' for layer in theme['layers'])
+        out.append(f'    {bits},')
+    out.append('};')
+    out.append('')
+
+    out.append('static const uint8_t PROGMEM theme_table[THEME_COUNT][THEME_LAYER_COUNT][3] = {')
+    for theme in themes:
+        out.append(f'    [THEME_{theme["name"].upper()}] = {{')
+        for layer, (h, s, v) in theme['layers'].items():
+            out.append(f'        [{layer}] = {{{h}, {s}, {v}}},')
+        out.append('    },')
+    out.append('};')
+    out.append('')
+
+    return '\n'.join(out)
+
+
+def main(argv):
+    if len(argv) != 4:
+        print(__doc__, file=sys.stderr)
+        return 1
+
+    try:
+        header = render(load_themes(argv[1], load_layers(argv[2])))
+    except (OSError, KeyError, ValueError) as e:
+        print(f'gen_themes.py: {e}', file=sys.stderr)
+        return 1
+
+    try:
+        with open(argv[3], encoding='utf-8') as f:
+            if f.read() == header:
+                return 0
+    except OSError:
+        pass
+
+    with open(argv[3], 'w', encoding='utf-8') as f:
+        f.write(header)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -0,0 +1,177 @@
+#include QMK_KEYBOARD_H
+#include "idle_governor.h"
+#include "sched.h"
+
+// Thresholds for IDLE_DIM..IDLE_OFF in ms, kept in ms so the task never multiplies
+static uint32_t stage_timeout[IDLE_STAGE_COUNT - 1] = {
+    (uint32_t)IDLE_DIM_TIMEOUT * 1000,
+    (uint32_t)IDLE_FREEZE_TIMEOUT * 1000,
+    (uint32_t)IDLE_OFF_TIMEOUT * 1000,
+};
+
+static idle_stage_t stage = IDLE_ACTIVE;
+static uint32_t last_activity = 0;
+
+// Time accounting per stage: whole seconds plus the leftover ms
+static uint32_t stage_since = 0;
+static uint32_t stage_seconds[IDLE_STAGE_COUNT] = {0};
+static uint16_t stage_carry_ms[IDLE_STAGE_COUNT] = {0};
+
+// Lighting as it was before idling started
+static struct {
+  bool enabled;
+  uint8_t mode;
+  uint8_t hue;
+  uint8_t sat;
+  uint8_t val;
+} saved;
+
+static void account_stage_time(void)
+{
+  uint32_t now = timer_read32();
+  uint32_t elapsed = TIMER_DIFF_32(now, stage_since) + stage_carry_ms[stage];
+
+  stage_seconds[stage] += elapsed / 1000;
+  stage_carry_ms[stage] = elapsed % 1000;
+  stage_since = now;
+}
+
+static void set_stage(idle_stage_t next)
+{
+  account_stage_time();
+  stage = next;
+}
+
+static void apply_stage(idle_stage_t next)
+{
+  if (!saved.enabled) {
+    return;
+  }
+
+  if (next == IDLE_OFF) {
+    rgblight_disable_noeeprom();
+    return;
+  }
+
+  // Stages are cumulative, but a disabled dim stage must not dim the later ones either
+  bool dim = next >= IDLE_DIM && stage_timeout[IDLE_DIM - 1] != 0;
+
+  rgblight_mode_noeeprom(next >= IDLE_FROZEN ? RGBLIGHT_MODE_STATIC_LIGHT : saved.mode);
+  rgblight_sethsv_noeeprom(saved.hue, saved.sat, dim ? saved.val >> IDLE_DIM_SHIFT : saved.val);
+}
+
+static void idle_governor_check(void);
+static sched_timer_t idle_timer = SCHED_TIMER(idle_governor_check, SCHED_IDLE_GOVERNOR);
+
+/*
+ * Arms the timer for the next enabled stage. Activity does not touch the
+ * timer while active; if it fires early the check simply re-arms it for
+ * the remaining time.
+ */
+static void arm_next_stage(void)
+{
+  uint32_t idle = timer_elapsed32(last_activity);
+
+  for (uint8_t i = stage; i < IDLE_STAGE_COUNT - 1; i++) {
+    if (stage_timeout[i]) {
+      sched_start(&idle_timer, stage_timeout[i] > idle ? stage_timeout[i] - idle : 0, 0);
+      return;
+    }
+  }
+  sched_stop(&idle_timer);
+}
+
+void idle_governor_activity(void)
+{
+  last_activity = timer_read32();
+
+  if (stage == IDLE_ACTIVE) {
+    return;
+  }
+
+  if (saved.enabled) {
+    rgblight_enable_noeeprom();
+    rgblight_mode_noeeprom(saved.mode);
+    rgblight_sethsv_noeeprom(saved.hue, saved.sat, saved.val);
+  }
+  set_stage(IDLE_ACTIVE);
+  arm_next_stage();
+}
+
+static void idle_governor_check(void)
+{
+  // Highest enabled stage whose threshold has passed
+  uint32_t idle = timer_elapsed32(last_activity);
+  idle_stage_t target = stage;
+  for (uint8_t i = stage; i < IDLE_STAGE_COUNT - 1; i++) {
+    if (stage_timeout[i] && idle >= stage_timeout[i]) {
+      target = i + 1;
+    }
+  }
+
+  if (target == stage) {
+    arm_next_stage();
+    return;
+  }
+
+  if (stage == IDLE_ACTIVE) {
+    saved.enabled = rgblight_is_enabled();
+    saved.mode = rgblight_get_mode();
+    saved.hue = rgblight_get_hue();
+    saved.sat = rgblight_get_sat();
+    saved.val = rgblight_get_val();
+  }
+  apply_stage(target);
+  set_stage(target);
+  arm_next_stage();
+}
+
+void idle_governor_init(void)
+{
+  last_activity = timer_read32();
+  stage_since = last_activity;
+  arm_next_stage();
+}
+
+void idle_governor_set_timeouts(uint16_t dim, uint16_t freeze, uint16_t off)
+{
+  stage_timeout[IDLE_DIM - 1] = (uint32_t)dim * 1000;
+  stage_timeout[IDLE_FROZEN - 1] = (uint32_t)freeze * 1000;
+  stage_timeout[IDLE_OFF - 1] = (uint32_t)off * 1000;
+  arm_next_stage();
+}
+
+void idle_governor_get_timeouts(uint16_t *dim, uint16_t *freeze, uint16_t *off)
+{
+  *dim = stage_timeout[IDLE_DIM - 1] / 1000;
+  *freeze = stage_timeout[IDLE_FROZEN - 1] / 1000;
+  *off = stage_timeout[IDLE_OFF - 1] / 1000;
+}
+
+idle_stage_t idle_governor_stage(void)
+{
+  return stage;
+}
+
+void idle_governor_get_lighting(uint8_t *mode, uint8_t *hue, uint8_t *sat, uint8_t *val)
+{
+  // Idling leaves disabled lighting alone, so the live state is still the real one
+  if (stage != IDLE_ACTIVE && saved.enabled) {
+    *mode = saved.mode;
+    *hue = saved.hue;
+    *sat = saved.sat;
+    *val = saved.val;
+    return;
+  }
+
+  *mode = rgblight_get_mode();
+  *hue = rgblight_get_hue();
+  *sat = rgblight_get_sat();
+  *val = rgblight_get_val();
+}
+
+uint32_t idle_governor_stage_seconds(idle_stage_t which)
+{
+  account_stage_time();
+  return stage_seconds[which];
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+
+// Default idle thresholds in seconds since the last key or encoder event; 0 disables a stage
+#ifndef IDLE_DIM_TIMEOUT
+#define IDLE_DIM_TIMEOUT 60
+#endif
+#ifndef IDLE_FREEZE_TIMEOUT
+#define IDLE_FREEZE_TIMEOUT 300
+#endif
+#ifndef IDLE_OFF_TIMEOUT
+#define IDLE_OFF_TIMEOUT 900
+#endif
+
+// Brightness is shifted right by this much while dimmed (2 = quarter brightness)
+#ifndef IDLE_DIM_SHIFT
+#define IDLE_DIM_SHIFT 2
+#endif
+
+// Stages are ordered: each one keeps the savings of the ones before it
+typedef enum {
+  IDLE_ACTIVE = 0, // Normal lighting
+  IDLE_DIM,        // Reduced brightness
+  IDLE_FROZEN,     // Animation stopped (and dimmed unless dimming is disabled)
+  IDLE_OFF,        // LEDs off
+  IDLE_STAGE_COUNT
+} idle_stage_t;
+
+/*
+ * Records user activity and instantly restores lighting if it was idled.
+ * Lighting is only ever changed with the _noeeprom rgblight calls, so
+ * idling never writes to EEPROM.
+ */
+void idle_governor_activity(void);
+
+/*
+ * Arms the timer that steps through the idle stages
+ */
+void idle_governor_init(void);
+
+/*
+ * Sets the idle thresholds in seconds; 0 disables a stage
+ */
+void idle_governor_set_timeouts(uint16_t dim, uint16_t freeze, uint16_t off);
+void idle_governor_get_timeouts(uint16_t *dim, uint16_t *freeze, uint16_t *off);
+
+idle_stage_t idle_governor_stage(void);
+
+/*
+ * Lighting as the user set it: while idled this is the state saved before
+ * idling started, not the dimmed or frozen one currently shown
+ */
+void idle_governor_get_lighting(uint8_t *mode, uint8_t *hue, uint8_t *sat, uint8_t *val);
+
+/*
+ * Total whole seconds spent in a stage since boot
+ */
+uint32_t idle_governor_stage_seconds(idle_stage_t stage);
@@ -1,4 +1,5 @@
 #include QMK_KEYBOARD_H
+#include <string.h>
 
 // Define RAW_EPSIZE before including raw_hid.h
 #ifndef RAW_EPSIZE
@@ -6,41 +7,13 @@
 #endif
 
 #include "raw_hid.h"
+#include "mem_stats.h"
+#include "idle_governor.h"
+#include "sched.h"
 
 // RGB configuration
 #define RGBLIGHT_LAYERS
 
-// RGB colors (using HSV values)
-#define GAMING_HUE 0 // Vibrant Red
-
-#define GAMING_SAT 255
-#define GAMING_VAL 200
-
-#define MAC_HUE 190 // Cyan/Turquoise
-#define MAC_SAT 255
-#define MAC_VAL 200
-
-#define WIN_HUE 135 // Spring Green
-#define WIN_SAT 255
-#define WIN_VAL 200
-
-// Layer indication colors
-#define MEDIA_HUE 213 // Magenta
-#define MEDIA_SAT 255
-#define MEDIA_VAL 150
-
-#define NAV_HUE 43 // Golden Yellow
-#define NAV_SAT 255
-#define NAV_VAL 150
-
-#define SYM_HUE 28 // Orange
-#define SYM_SAT 255
-#define SYM_VAL 150
-
-#define NUM_HUE 170 // Azure Blue
-#define NUM_SAT 255
-#define NUM_VAL 150
-
 // OS Detection configuration
 #define OS_DETECTION_DEBOUNCE 250  // 250ms debounce time
 #define OS_DETECTION_SINGLE_REPORT // Only report once when stable
@@ -67,6 +40,67 @@ enum cockpit_layer
   _ADJUST
 };
 
+// Layer and mode colors come from themes.json, see gen_themes.py
+#define THEME_LAYER_COUNT (_ADJUST + 1)
+#include "themes.h"
+
+// A theme uploaded over Raw HID, selectable right after the built-in ones.
+// It lives in the EEPROM user datablock, with a RAM copy so layer changes
+// never read EEPROM.
+#define THEME_CUSTOM THEME_COUNT
+#define THEME_CUSTOM_MAGIC 0xC7
+
+typedef struct __attribute__((packed)) {
+  uint8_t magic;       // THEME_CUSTOM_MAGIC once a table has been stored
+  uint16_t layer_mask; // Layers the theme sets a color for, as in theme_layer_mask
+  uint8_t hsv[THEME_LAYER_COUNT][3];
+} theme_custom_t;
+
+_Static_assert(sizeof(theme_custom_t) == EECONFIG_USER_DATA_SIZE, "EECONFIG_USER_DATA_SIZE in config.h must match theme_custom_t");
+
+static theme_custom_t theme_custom;
+
+static bool theme_custom_valid(void)
+{
+  return theme_custom.magic == THEME_CUSTOM_MAGIC;
+}
+
+// Built-in themes plus the custom one once it has been stored
+static uint8_t theme_count(void)
+{
+  return THEME_COUNT + (theme_custom_valid() ? 1 : 0);
+}
+
+// Persisted in the EEPROM user config word
+typedef union {
+  uint32_t raw;
+  struct {
+    uint8_t theme; // Index into theme_table, or THEME_CUSTOM
+  };
+} user_config_t;
+
+user_config_t user_config;
+
+// Applies the active theme's color for a layer, unless the theme leaves that layer alone
+static void set_layer_color(uint8_t layer)
+{
+  if (user_config.theme == THEME_CUSTOM)
+  {
+    if (theme_custom.layer_mask & (1 << layer))
+    {
+      rgblight_sethsv(theme_custom.hsv[layer][0], theme_custom.hsv[layer][1], theme_custom.hsv[layer][2]);
+    }
+    return;
+  }
+
+  if (!(pgm_read_word(&theme_layer_mask[user_config.theme]) & (1 << layer)))
+  {
+    return;
+  }
+  const uint8_t *hsv = theme_table[user_config.theme][layer];
+  rgblight_sethsv(pgm_read_byte(&hsv[0]), pgm_read_byte(&hsv[1]), pgm_read_byte(&hsv[2]));
+}
+
 // OS detection and manual override state
 bool is_mac_mode = false;        // Default to Windows mode
 bool manual_os_override = false; // Track if user manually set the OS
@@ -90,13 +124,45 @@ bool white_mode = false;  // Track if we're in white mode within Skadis mode
 #define RGBLIGHT_EFFECT_STATIC_GRADIENT
 #define RGBLIGHT_EFFECT_TWINKLE
 
+// Base layer picked by OS detection: always turns the LEDs on and shows its color, even in Skadis mode
+static void set_detected_base_layer(uint8_t layer)
+{
+  layer_move(layer);
+  rgblight_enable();
+  set_layer_color(layer);
+}
+
+// Switches the base layer; layer_state_set_user applies its color
+static void set_base_layer(uint8_t layer)
+{
+  if (!skadis_mode)
+  { // Only change colors if not in Skadis mode
+    rgblight_enable();
+  }
+  layer_move(layer);
+}
+
+void eeconfig_init_user(void)
+{
+  user_config.raw = 0;
+  user_config.theme = THEME_DEFAULT;
+  eeconfig_update_user(user_config.raw);
+}
+
 // Keyboard initialization
 void keyboard_post_init_user(void)
 {
+  user_config.raw = eeconfig_read_user();
+  eeconfig_read_user_datablock(&theme_custom, 0, sizeof(theme_custom));
+  if (user_config.theme >= theme_count())
+  {
+    user_config.theme = THEME_DEFAULT;
+  }
+
   // Initialize RGB
   rgblight_enable();
   rgblight_mode(RGBLIGHT_MODE_STATIC_LIGHT);
-  rgblight_sethsv(WIN_HUE, WIN_SAT, WIN_VAL); // Start with green for Windows mode
+  set_layer_color(_WIN_MODE); // Start with the Windows mode color
 
   // Start in Windows mode by default
   is_mac_mode = false;
@@ -105,6 +171,9 @@ void keyboard_post_init_user(void)
   white_mode = false;
   layer_clear();
   layer_on(_WIN_MODE);
+
+  mem_stats_init();
+  idle_governor_init();
 }
 
 // OS Detection callback
@@ -115,6 +184,9 @@ bool process_detected_host_os_kb(os_variant_t detected_os)
     return false;
   }
 
+  // A host (re)connecting counts as activity, so colors below are not applied to idled LEDs
+  idle_governor_activity();
+
   // Only switch if no manual override
   if (!manual_os_override)
   {
@@ -125,9 +197,7 @@ bool process_detected_host_os_kb(os_variant_t detected_os)
       if (!is_mac_mode)
       {
         is_mac_mode = true;
-        layer_move(_MAC_MODE); // Switch to Mac base layer
-        rgblight_enable();
-        rgblight_sethsv(MAC_HUE, MAC_SAT, MAC_VAL);
+        set_detected_base_layer(_MAC_MODE); // Switch to Mac base layer
       }
       break;
     case OS_WINDOWS:
@@ -135,18 +205,14 @@ bool process_detected_host_os_kb(os_variant_t detected_os)
       if (is_mac_mode)
       {
         is_mac_mode = false;
-        layer_move(_WIN_MODE); // Switch to Windows base layer
-        rgblight_enable();
-        rgblight_sethsv(WIN_HUE, WIN_SAT, WIN_VAL);
+        set_detected_base_layer(_WIN_MODE); // Switch to Windows base layer
       }
       break;
     case OS_UNSURE:
       // Keep current state if unsure, but ensure we're in a valid layer
       if (!layer_state)
       {
-        layer_on(_WIN_MODE); // Default to Windows mode if no layer is active
-        rgblight_enable();
-        rgblight_sethsv(WIN_HUE, WIN_SAT, WIN_VAL);
+        set_detected_base_layer(_WIN_MODE); // Default to Windows mode if no layer is active
       }
       break;
     }
@@ -417,9 +483,19 @@ const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
         _______, _______, _______),
 };
 
-static uint16_t app_switcher_timer = 0;
+// GUI is held while the encoder flips through apps and released this long after the last step
+#define APP_SWITCHER_TIMEOUT 500
+
 static bool app_switcher_active = false;
 
+static void app_switcher_release(void)
+{
+  unregister_code(KC_LGUI);
+  app_switcher_active = false;
+}
+
+static sched_timer_t app_switcher_timer = SCHED_TIMER(app_switcher_release, SCHED_APP_SWITCHER);
+
 /*
  * Handles encoder rotation events for both left and right encoders
  *
@@ -429,6 +505,8 @@ static bool app_switcher_active = false;
  */
 bool encoder_update_user(uint8_t index, bool clockwise)
 {
+  idle_governor_activity();
+
   uint8_t layer = get_highest_layer(layer_state);
   bool shift_pressed = get_mods() & MOD_BIT(KC_LSFT);
 
@@ -482,7 +560,7 @@ bool encoder_update_user(uint8_t index, bool clockwise)
 
       default: {
         // App switcher (GUI+Tab) functionality
-        app_switcher_timer = timer_read();
+        sched_start(&app_switcher_timer, APP_SWITCHER_TIMEOUT, 0);
 
         if (!app_switcher_active) {
           app_switcher_active = true;
@@ -523,15 +601,11 @@ bool encoder_update_user(uint8_t index, bool clockwise)
 }
 
 /*
- * Handles app switcher functionality
+ * Runs timed work (app switcher release, idle stages, stack scans) from the scheduler
  */
 void matrix_scan_user(void)
 {
-  if (app_switcher_active && timer_elapsed(app_switcher_timer) > 500)
-  {
-    unregister_code(KC_LGUI);
-    app_switcher_active = false;
-  }
+  sched_task();
 }
 
 /*
@@ -547,6 +621,8 @@ void matrix_scan_user(void)
  */
 bool process_record_user(uint16_t keycode, keyrecord_t *record)
 {
+  idle_governor_activity();
+
   switch (keycode)
   {
   case SKADIS_MODE:
@@ -573,11 +649,7 @@ bool process_record_user(uint16_t keycode, keyrecord_t *record)
     {
       is_mac_mode = true;
       manual_os_override = true;
-      layer_move(_MAC_MODE);
-      if (!skadis_mode) {  // Only change colors if not in Skadis mode
-        rgblight_enable();
-        rgblight_sethsv(MAC_HUE, MAC_SAT, MAC_VAL);
-      }
+      set_base_layer(_MAC_MODE);
     }
     return false;
   case WIN_MODE:
@@ -585,11 +657,7 @@ bool process_record_user(uint16_t keycode, keyrecord_t *record)
     {
       is_mac_mode = false;
       manual_os_override = true;
-      layer_move(_WIN_MODE);
-      if (!skadis_mode) {  // Only change colors if not in Skadis mode
-        rgblight_enable();
-        rgblight_sethsv(WIN_HUE, WIN_SAT, WIN_VAL);
-      }
+      set_base_layer(_WIN_MODE);
     }
     return false;
   case GAME_MODE:
@@ -597,11 +665,7 @@ bool process_record_user(uint16_t keycode, keyrecord_t *record)
     {
       is_mac_mode = false;
       manual_os_override = true;
-      layer_move(_GAME_MODE);
-      if (!skadis_mode) {  // Only change colors if not in Skadis mode
-        rgblight_enable();
-        rgblight_sethsv(GAMING_HUE, GAMING_SAT, GAMING_VAL);
-      }
+      set_base_layer(_GAME_MODE);
     }
     return false;
   case KC_MY_COPY:
@@ -652,30 +716,7 @@ bool process_record_user(uint16_t keycode, keyrecord_t *record)
 layer_state_t layer_state_set_user(layer_state_t state)
 {
   if (!skadis_mode) {  // Only change colors if not in Skadis mode
-    switch (get_highest_layer(state))
-    {
-    case _MEDIA:
-      rgblight_sethsv(MEDIA_HUE, MEDIA_SAT, MEDIA_VAL);
-      break;
-    case _NAV:
-      rgblight_sethsv(NAV_HUE, NAV_SAT, NAV_VAL);
-      break;
-    case _SYM:
-      rgblight_sethsv(SYM_HUE, SYM_SAT, SYM_VAL);
-      break;
-    case _NUM:
-      rgblight_sethsv(NUM_HUE, NUM_SAT, NUM_VAL);
-      break;
-    case _MAC_MODE:
-      rgblight_sethsv(MAC_HUE, MAC_SAT, MAC_VAL);
-      break;
-    case _WIN_MODE:
-      rgblight_sethsv(WIN_HUE, WIN_SAT, WIN_VAL);
-      break;
-    case _GAME_MODE:
-      rgblight_sethsv(GAMING_HUE, GAMING_SAT, GAMING_VAL);
-      break;
-    }
+    set_layer_color(get_highest_layer(state));
   }
   return state;
 }
@@ -688,12 +729,62 @@ layer_state_t layer_state_set_user(layer_state_t state)
 #define CMD_RGB_ANIMATION 0x05
 #define CMD_GET_STATE 0x0F
 #define CMD_SET_DIRECTION 0x06
+#define CMD_GET_MEM_STATS 0x07
+#define CMD_SET_IDLE_TIMEOUTS 0x08
+#define CMD_GET_IDLE_STATS 0x09
+#define CMD_SET_THEME 0x0A
+#define CMD_GET_SCHED_STATS 0x0B
+#define CMD_SET_CUSTOM_THEME 0x0C
 #define CMD_GET_VERSION 0x0E
 
+// Multi-byte fields are little-endian
+static uint16_t get_u16(const uint8_t *buf) {
+    return buf[0] | ((uint16_t)buf[1] << 8);
+}
+
+static void put_u16(uint8_t *buf, uint16_t value) {
+    buf[0] = value & 0xFF;
+    buf[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *buf, uint32_t value) {
+    put_u16(buf, value & 0xFFFF);
+    put_u16(buf + 2, value >> 16);
+}
+
+static void put_idle_timeouts(uint8_t *buf) {
+    uint16_t dim, freeze, off;
+    idle_governor_get_timeouts(&dim, &freeze, &off);
+    put_u16(&buf[0], dim);
+    put_u16(&buf[2], freeze);
+    put_u16(&buf[4], off);
+}
+
+// Commands that change the lighting; they wake idled LEDs first so they apply to the real state
+static bool is_lighting_command(uint8_t command) {
+    switch (command) {
+        case CMD_SKADIS_MODE:
+        case CMD_WHITE_MODE:
+        case CMD_RGB_EFFECT:
+        case CMD_RGB_COLOR:
+        case CMD_RGB_ANIMATION:
+        case CMD_SET_DIRECTION:
+        case CMD_SET_THEME:
+        case CMD_SET_CUSTOM_THEME:
+            return true;
+        default:
+            return false;
+    }
+}
+
 void raw_hid_receive(uint8_t *data, uint8_t length) {
     uint8_t command = data[0];
     uint8_t response[32] = {0};  // Use fixed size of 32 instead of RAW_EPSIZE
     response[0] = command; // Echo back the command in responses
+
+    if (is_lighting_command(command)) {
+        idle_governor_activity();
+    }
     
     switch (command) {
         case CMD_SKADIS_MODE:
@@ -732,7 +823,12 @@ void raw_hid_receive(uint8_t *data, uint8_t length) {
                 uint8_t hue = data[1];
                 uint8_t sat = data[2];
                 uint8_t val = data[3];
-                rgblight_sethsv(hue, sat, val);
+                // data[4] set: streamed color (e.g. audio mode), skip the EEPROM write
+                if (data[4]) {
+                    rgblight_sethsv_noeeprom(hue, sat, val);
+                } else {
+                    rgblight_sethsv(hue, sat, val);
+                }
                 response[1] = rgblight_get_hue();
                 response[2] = rgblight_get_sat();
                 response[3] = rgblight_get_val();
@@ -748,10 +844,8 @@ void raw_hid_receive(uint8_t *data, uint8_t length) {
             break;
 
         case CMD_GET_STATE:  // 0x0F
-            response[1] = rgblight_get_mode();
-            response[2] = rgblight_get_hue();
-            response[3] = rgblight_get_sat();
-            response[4] = rgblight_get_val();
+            // Reports the lighting as set, not as dimmed by the idle governor, without waking it
+            idle_governor_get_lighting(&response[1], &response[2], &response[3], &response[4]);
             response[5] = rgblight_get_speed();
             response[6] = skadis_mode;
             response[7] = white_mode;
@@ -770,6 +864,82 @@ void raw_hid_receive(uint8_t *data, uint8_t length) {
             }
             break;
 
+        case CMD_GET_MEM_STATS: {
+            mem_stats_t stats;
+            mem_stats_get(&stats);
+            put_u16(&response[1], stats.ram_size);
+            put_u16(&response[3], stats.data_size);
+            put_u16(&response[5], stats.bss_size);
+            put_u16(&response[7], stats.stack_size);
+            put_u16(&response[9], stats.stack_peak);
+            put_u16(&response[11], stats.stack_now);
+            break;
+        }
+
+        case CMD_SET_IDLE_TIMEOUTS:
+            idle_governor_set_timeouts(get_u16(&data[1]), get_u16(&data[3]), get_u16(&data[5]));
+            put_idle_timeouts(&response[1]);
+            break;
+
+        case CMD_GET_IDLE_STATS:
+            response[1] = idle_governor_stage();
+            put_idle_timeouts(&response[2]);
+            for (uint8_t i = 0; i < IDLE_STAGE_COUNT; i++) {
+                put_u32(&response[8 + i * 4], idle_governor_stage_seconds(i));
+            }
+            break;
+
+        case CMD_SET_THEME:
+            // data[1] = theme index (out of range just reads back), data[2] = save to EEPROM
+            if (data[1] < theme_count()) {
+                user_config.theme = data[1];
+                if (data[2]) {
+                    eeconfig_update_user(user_config.raw);
+                }
+                if (!skadis_mode) {
+                    set_layer_color(get_highest_layer(layer_state));
+                }
+            }
+            response[1] = user_config.theme;
+            response[2] = theme_count();
+            break;
+
+        case CMD_SET_CUSTOM_THEME:
+            // data[1] = 1 to store the table below, 0 to erase the custom theme
+            // data[2..3] = layer mask, data[4..] = THEME_LAYER_COUNT hsv triples
+            if (data[1]) {
+                theme_custom.magic = THEME_CUSTOM_MAGIC;
+                theme_custom.layer_mask = get_u16(&data[2]) & ((1 << THEME_LAYER_COUNT) - 1);
+                memcpy(theme_custom.hsv, &data[4], sizeof(theme_custom.hsv));
+            } else {
+                memset(&theme_custom, 0, sizeof(theme_custom));
+                if (user_config.theme == THEME_CUSTOM) {
+                    user_config.theme = THEME_DEFAULT;
+                    eeconfig_update_user(user_config.raw);
+                }
+            }
+            eeconfig_update_user_datablock(&theme_custom, 0, sizeof(theme_custom));
+            if (!skadis_mode) {
+                set_layer_color(get_highest_layer(layer_state));
+            }
+            response[1] = theme_custom_valid();
+            response[2] = THEME_CUSTOM;
+            response[3] = THEME_LAYER_COUNT;
+            break;
+
+        case CMD_GET_SCHED_STATS:
+            // data[1] = timer id (sched_timer_id_t); out of range only reports the counts
+            response[1] = SCHED_TIMER_COUNT;
+            response[2] = sched_pending();
+            if (data[1] < SCHED_TIMER_COUNT) {
+                sched_stats_t stats;
+                sched_get_stats(data[1], &stats);
+                put_u32(&response[3], stats.dispatches);
+                put_u32(&response[7], stats.total_late);
+                put_u16(&response[11], stats.max_late);
+            }
+            break;
+
         case CMD_GET_VERSION:
             response[1] = FIRMWARE_VERSION_MAJOR;
             response[2] = FIRMWARE_VERSION_MINOR;
@@ -0,0 +1,74 @@
+#include QMK_KEYBOARD_H
+#include "mem_stats.h"
+#include "sched.h"
+
+// Section boundaries provided by the avr-libc linker script
+extern uint8_t __data_start;
+extern uint8_t __data_end;
+extern uint8_t __bss_start;
+extern uint8_t __bss_end;
+extern uint8_t __noinit_start;
+extern uint8_t __noinit_end;
+extern uint8_t _end;
+
+// Lowest address the stack is known to have reached
+static uint16_t stack_low = RAMEND + 1;
+
+/*
+ * Paints everything between the end of statics and the top of RAM with
+ * STACK_CANARY. Runs from .init1, before the C runtime has set up the stack
+ * pointer or __zero_reg__, so it must stay in plain assembly.
+ */
+void mem_stats_paint_stack(void) __attribute__((naked, used, section(".init1")));
+void mem_stats_paint_stack(void)
+{
+  __asm volatile(
+      "    ldi r30, lo8(_end)\n"
+      "    ldi r31, hi8(_end)\n"
+      "    ldi r24, %0\n"
+      "    ldi r25, hi8(__stack)\n"
+      "    rjmp 2f\n"
+      "1:  st Z+, r24\n"
+      "2:  cpi r30, lo8(__stack)\n"
+      "    cpc r31, r25\n"
+      "    brlo 1b\n"
+      "    breq 1b\n"
+      :
+      : "M"(STACK_CANARY));
+}
+
+/*
+ * The stack only grows downwards, so the high-water mark can only move
+ * down too. Only the still-painted region below the previous mark needs
+ * to be walked.
+ */
+static void mem_stats_scan(void)
+{
+  const uint8_t *p = &_end;
+  const uint8_t *limit = (const uint8_t *)stack_low;
+
+  while (p < limit && *p == STACK_CANARY) {
+    p++;
+  }
+  stack_low = (uint16_t)p;
+}
+
+static sched_timer_t scan_timer = SCHED_TIMER(mem_stats_scan, SCHED_MEM_SCAN);
+
+void mem_stats_init(void)
+{
+  sched_start(&scan_timer, MEM_STATS_SCAN_INTERVAL, MEM_STATS_SCAN_INTERVAL);
+}
+
+void mem_stats_get(mem_stats_t *stats)
+{
+  mem_stats_scan();
+
+  stats->ram_size = RAMEND - RAMSTART + 1;
+  stats->data_size = (uint16_t)&__data_end - (uint16_t)&__data_start;
+  stats->bss_size = ((uint16_t)&__bss_end - (uint16_t)&__bss_start) +
+                    ((uint16_t)&__noinit_end - (uint16_t)&__noinit_start);
+  stats->stack_size = RAMEND + 1 - (uint16_t)&_end;
+  stats->stack_peak = RAMEND + 1 - stack_low;
+  stats->stack_now = RAMEND - SP;
+}
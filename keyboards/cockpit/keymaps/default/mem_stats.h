@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+
+// Byte painted over free SRAM at boot; anything still holding it was never used by the stack
+#define STACK_CANARY 0xC5
+
+// How often (ms) the stack high-water mark is refreshed
+#ifndef MEM_STATS_SCAN_INTERVAL
+#define MEM_STATS_SCAN_INTERVAL 1000
+#endif
+
+// SRAM usage snapshot, all values in bytes
+typedef struct {
+  uint16_t ram_size;   // Total SRAM on the MCU
+  uint16_t data_size;  // Initialised statics (.data)
+  uint16_t bss_size;   // Zeroed and uninitialised statics (.bss + .noinit)
+  uint16_t stack_size; // Space left between the end of statics and the top of RAM
+  uint16_t stack_peak; // Deepest stack use seen since boot
+  uint16_t stack_now;  // Stack use at the time of the call
+} mem_stats_t;
+
+/*
+ * Starts refreshing the stack high-water mark every MEM_STATS_SCAN_INTERVAL
+ */
+void mem_stats_init(void);
+
+/*
+ * Fills in a snapshot of current SRAM usage, rescanning the stack first
+ */
+void mem_stats_get(mem_stats_t *stats);
@@ -16,3 +16,13 @@ OS_DETECTION_ENABLE = yes  # Enable OS detection
 # Disable unnecessary features to save space
 SPACE_CADET_ENABLE = no
 MAGIC_ENABLE = no
+
+# Keymap sources
+SRC += sched.c mem_stats.c idle_governor.c
+
+# Regenerate the PROGMEM theme table from themes.json; themes.h is only rewritten when it changes
+THEMES_DIR := $(patsubst %/,%,$(dir $(lastword $(MAKEFILE_LIST))))
+THEMES_GEN := $(shell python3 $(THEMES_DIR)/gen_themes.py $(THEMES_DIR)/themes.json $(THEMES_DIR)/keymap.c $(THEMES_DIR)/themes.h || echo failed)
+ifneq ($(THEMES_GEN),)
+    $(error gen_themes.py could not generate themes.h)
+endif
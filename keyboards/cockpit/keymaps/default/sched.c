@@ -0,0 +1,114 @@
+#include QMK_KEYBOARD_H
+#include "sched.h"
+
+// Pending timers, earliest deadline first
+static sched_timer_t *head = NULL;
+// Deadline of head, cached so the idle path is a single comparison
+static uint32_t next_deadline = 0;
+static bool armed = false;
+
+static sched_stats_t stats[SCHED_TIMER_COUNT] = {0};
+static uint8_t pending_count = 0;
+
+// Wrap-safe "a is before b" for 32-bit millisecond timestamps
+static inline bool before(uint32_t a, uint32_t b)
+{
+  return (int32_t)(a - b) < 0;
+}
+
+static void update_next(void)
+{
+  armed = head != NULL;
+  if (armed) {
+    next_deadline = head->deadline;
+  }
+}
+
+static void list_remove(sched_timer_t *timer)
+{
+  for (sched_timer_t **link = &head; *link; link = &(*link)->next) {
+    if (*link == timer) {
+      *link = timer->next;
+      break;
+    }
+  }
+  timer->next = NULL;
+  timer->pending = false;
+  pending_count--;
+}
+
+static void list_insert(sched_timer_t *timer)
+{
+  sched_timer_t **link = &head;
+  // Equal deadlines keep insertion order
+  while (*link && !before(timer->deadline, (*link)->deadline)) {
+    link = &(*link)->next;
+  }
+  timer->next = *link;
+  *link = timer;
+  timer->pending = true;
+  pending_count++;
+}
+
+void sched_start(sched_timer_t *timer, uint32_t delay, uint32_t period)
+{
+  if (timer->pending) {
+    list_remove(timer);
+  }
+  timer->deadline = timer_read32() + delay;
+  timer->period = period;
+  list_insert(timer);
+  update_next();
+}
+
+void sched_stop(sched_timer_t *timer)
+{
+  if (timer->pending) {
+    list_remove(timer);
+    update_next();
+  }
+}
+
+void sched_task(void)
+{
+  if (!armed || before(timer_read32(), next_deadline)) {
+    return;
+  }
+
+  uint32_t now = timer_read32();
+  while (head && !before(now, head->deadline)) {
+    sched_timer_t *timer = head;
+    uint32_t late = now - timer->deadline;
+    sched_stats_t *s = &stats[timer->id];
+
+    s->dispatches++;
+    s->total_late += late;
+    if (late > s->max_late) {
+      s->max_late = late > UINT16_MAX ? UINT16_MAX : late;
+    }
+
+    list_remove(timer);
+    if (timer->period) {
+      // Stay on the original grid unless a stall already made the next slot late
+      timer->deadline += timer->period;
+      if (before(timer->deadline, now)) {
+        timer->deadline = now + timer->period;
+      }
+      list_insert(timer);
+    }
+
+    // The callback may start or stop any timer, including this one
+    timer->callback();
+  }
+  update_next();
+}
+
+void sched_get_stats(sched_timer_id_t id, sched_stats_t *out)
+{
+  *out = stats[id];
+}
+
+uint8_t sched_pending(void)
+{
+  return pending_count;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Timers whose dispatch accuracy is tracked separately; order must match SCHED_TIMERS in led_control
+typedef enum {
+  SCHED_APP_SWITCHER = 0,
+  SCHED_IDLE_GOVERNOR,
+  SCHED_MEM_SCAN,
+  SCHED_TIMER_COUNT
+} sched_timer_id_t;
+
+/*
+ * Timer owned by the caller, usually a static. Pending timers are kept in
+ * a list sorted by deadline, so the per-scan check only ever looks at the
+ * head no matter how many timers are pending.
+ */
+typedef struct sched_timer {
+  void (*callback)(void);
+  uint32_t deadline;
+  uint32_t period; // 0 for one-shot timers
+  uint8_t id;      // sched_timer_id_t, selects the stats slot
+  bool pending;
+  struct sched_timer *next;
+} sched_timer_t;
+
+#define SCHED_TIMER(cb, timer_id) { .callback = (cb), .id = (timer_id) }
+
+// Dispatch accuracy of one timer since boot, lateness measured against the requested deadline
+typedef struct {
+  uint32_t dispatches;
+  uint32_t total_late; // ms
+  uint16_t max_late;   // ms
+} sched_stats_t;
+
+/*
+ * Starts or restarts a timer. The callback runs delay ms from now and then
+ * every period ms if period is not 0. Restarting a pending timer moves its
+ * deadline.
+ */
+void sched_start(sched_timer_t *timer, uint32_t delay, uint32_t period);
+
+/*
+ * Cancels a timer; does nothing if it is not pending
+ */
+void sched_stop(sched_timer_t *timer);
+
+/*
+ * Runs due callbacks. Called every matrix scan; costs one comparison
+ * while nothing is due.
+ */
+void sched_task(void);
+
+void sched_get_stats(sched_timer_id_t id, sched_stats_t *stats);
+
+/*
+ * Number of timers currently waiting to run
+ */
+uint8_t sched_pending(void);
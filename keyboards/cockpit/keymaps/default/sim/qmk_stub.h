@@ -0,0 +1,10 @@
+#pragma once
+
+// Stands in for QMK_KEYBOARD_H when the scheduler is built on the host
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Millisecond clock, driven by the simulation
+uint32_t timer_read32(void);
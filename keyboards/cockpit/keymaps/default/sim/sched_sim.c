@@ -0,0 +1,194 @@
+/*
+ * Host simulation of sched.c, measuring dispatch accuracy under a modelled
+ * main loop. Build and run from the keymap directory:
+ *
+ *   cc -std=c11 -O2 -Wall -Wextra -I. -Isim -DQMK_KEYBOARD_H='"qmk_stub.h"' \
+ *      sim/sched_sim.c sched.c -o sched_sim && ./sched_sim
+ *
+ * The firmware clock only has 1 ms resolution, so the simulated clock runs
+ * in microseconds and each loop iteration takes a varying amount of time.
+ * Lateness is reported both as the firmware counts it (whole ms against
+ * timer_read32()) and in us from the moment the deadline was reached.
+ * The loop costs below are estimates for an ATmega32U4 at 16 MHz, not
+ * measurements; `led-control sched` reports the real figures from a board.
+ *
+ * It also checks that no callback ever runs before its deadline, including
+ * across the 32-bit millisecond wrap, and that restarting a timer drops the
+ * old deadline. Exits non-zero if a check fails.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "sched.h"
+
+// Simulated time, starting shortly before timer_read32() wraps
+static uint64_t now_us = (UINT64_C(0x100000000) - 60000) * 1000;
+
+uint32_t timer_read32(void)
+{
+  return (uint32_t)(now_us / 1000);
+}
+
+#define SIM_HOURS 2
+
+// Main loop model, in us
+#define SCAN_US 350          // Matrix scan, encoders and rgblight task
+#define SCAN_JITTER_US 300   // Uniform extra on top of SCAN_US
+#define LED_FRAME_US 450     // WS2812 frame for 15 LEDs, interrupts off
+#define LED_FRAME_EVERY 40   // Iterations between animation frames
+#define HID_US 300           // Raw HID report handling
+#define HID_EVERY 2000       // Iterations between host reports
+#define EEPROM_US 13600      // 4-byte EEPROM update
+#define EEPROM_EVERY 200000  // Iterations between EEPROM writes
+
+// Lateness histogram per timer in HIST_BIN_US steps; the last bin collects everything beyond
+#define HIST_BIN_US 50
+#define HIST_BINS 400
+
+static struct {
+  const char *name;
+  sched_timer_t *timer;
+  uint32_t expected; // Deadline the simulation expects for the next run
+  uint32_t period;
+  uint32_t hist[HIST_BINS + 1];
+  uint64_t total_us;
+  uint32_t max_us;
+} sim[SCHED_TIMER_COUNT];
+
+static unsigned failures = 0;
+
+static uint32_t rand_range(uint32_t lo, uint32_t hi)
+{
+  return lo + (uint32_t)(((uint64_t)rand() * (hi - lo + 1)) / ((uint64_t)RAND_MAX + 1));
+}
+
+static void on_fire(sched_timer_id_t id)
+{
+  int32_t late_ms = (int32_t)(timer_read32() - sim[id].expected);
+
+  if (late_ms < 0) {
+    printf("FAIL: %s ran %ld ms early\n", sim[id].name, (long)-late_ms);
+    failures++;
+    late_ms = 0;
+  }
+
+  // The deadline was reached when the ms counter ticked over to it
+  uint32_t late_us = (uint32_t)late_ms * 1000 + (uint32_t)(now_us % 1000);
+  uint32_t bin = late_us / HIST_BIN_US;
+
+  sim[id].hist[bin > HIST_BINS ? HIST_BINS : bin]++;
+  sim[id].total_us += late_us;
+  if (late_us > sim[id].max_us) {
+    sim[id].max_us = late_us;
+  }
+  sim[id].expected += sim[id].period;
+}
+
+static void start(sched_timer_id_t id, uint32_t delay, uint32_t period)
+{
+  sim[id].expected = timer_read32() + delay;
+  sim[id].period = period;
+  sched_start(sim[id].timer, delay, period);
+}
+
+static void app_switcher_cb(void)
+{
+  on_fire(SCHED_APP_SWITCHER);
+}
+
+static void idle_cb(void)
+{
+  on_fire(SCHED_IDLE_GOVERNOR);
+  // Stand-in for the governor arming its next stage
+  start(SCHED_IDLE_GOVERNOR, rand_range(1000, 60000), 0);
+}
+
+static void mem_scan_cb(void)
+{
+  uint32_t now = timer_read32();
+
+  on_fire(SCHED_MEM_SCAN);
+  // A stall can push a periodic timer off its grid; follow the rescheduled slot
+  if ((int32_t)(sim[SCHED_MEM_SCAN].expected - now) <= 0) {
+    sim[SCHED_MEM_SCAN].expected = now + sim[SCHED_MEM_SCAN].period;
+  }
+}
+
+static sched_timer_t app_switcher_timer = SCHED_TIMER(app_switcher_cb, SCHED_APP_SWITCHER);
+static sched_timer_t idle_timer = SCHED_TIMER(idle_cb, SCHED_IDLE_GOVERNOR);
+static sched_timer_t mem_scan_timer = SCHED_TIMER(mem_scan_cb, SCHED_MEM_SCAN);
+
+// Upper edge of the histogram bin holding the given fraction of runs, in us
+static uint32_t percentile(const uint32_t *hist, uint32_t count, double p)
+{
+  uint32_t seen = 0;
+  for (uint32_t bin = 0; bin <= HIST_BINS; bin++) {
+    seen += hist[bin];
+    if (seen >= p * count) {
+      return (bin + 1) * HIST_BIN_US;
+    }
+  }
+  return (HIST_BINS + 1) * HIST_BIN_US;
+}
+
+int main(void)
+{
+  sim[SCHED_APP_SWITCHER].name = "app switcher";
+  sim[SCHED_APP_SWITCHER].timer = &app_switcher_timer;
+  sim[SCHED_IDLE_GOVERNOR].name = "idle governor";
+  sim[SCHED_IDLE_GOVERNOR].timer = &idle_timer;
+  sim[SCHED_MEM_SCAN].name = "stack scan";
+  sim[SCHED_MEM_SCAN].timer = &mem_scan_timer;
+
+  srand(1);
+  start(SCHED_MEM_SCAN, 1000, 1000);
+  start(SCHED_IDLE_GOVERNOR, 60000, 0);
+
+  const uint64_t end_us = now_us + (uint64_t)SIM_HOURS * 3600 * 1000000;
+  uint64_t next_turn_us = now_us;
+  uint32_t wraps = 0, last = timer_read32();
+
+  for (uint32_t iter = 1; now_us < end_us; iter++) {
+    // Encoder turns come in bursts; each one restarts the 500 ms release
+    if (now_us >= next_turn_us) {
+      start(SCHED_APP_SWITCHER, 500, 0);
+      next_turn_us = now_us + (rand_range(0, 3) ? rand_range(30, 200) : rand_range(600, 8000)) * (uint64_t)1000;
+    }
+
+    sched_task();
+
+    now_us += SCAN_US + rand_range(0, SCAN_JITTER_US);
+    if (iter % LED_FRAME_EVERY == 0) now_us += LED_FRAME_US;
+    if (iter % HID_EVERY == 0) now_us += HID_US;
+    if (iter % EEPROM_EVERY == 0) now_us += EEPROM_US;
+
+    if (timer_read32() < last) wraps++;
+    last = timer_read32();
+  }
+
+  printf("%d h simulated, %u timer wrap(s), %u timers pending at the end\n\n", SIM_HOURS, wraps, sched_pending());
+  printf("%-14s %8s | %8s %8s %8s | %8s %8s\n", "", "", "mean us", "p99 us", "max us", "fw mean", "fw max");
+  printf("%-14s %8s | %8s %8s %8s | %8s %8s\n", "timer", "runs", "", "", "", "ms", "ms");
+  for (uint8_t id = 0; id < SCHED_TIMER_COUNT; id++) {
+    sched_stats_t stats;
+    sched_get_stats(id, &stats);
+
+    uint32_t counted = 0;
+    for (uint32_t bin = 0; bin <= HIST_BINS; bin++) counted += sim[id].hist[bin];
+    if (counted != stats.dispatches) {
+      printf("FAIL: %s ran %lu times, scheduler counted %lu\n", sim[id].name,
+             (unsigned long)counted, (unsigned long)stats.dispatches);
+      failures++;
+    }
+
+    printf("%-14s %8lu | %8.0f %8lu %8lu | %8.3f %8u\n", sim[id].name, (unsigned long)counted,
+           counted ? (double)sim[id].total_us / counted : 0.0,
+           (unsigned long)percentile(sim[id].hist, counted, 0.99), (unsigned long)sim[id].max_us,
+           stats.dispatches ? (double)stats.total_late / stats.dispatches : 0.0, stats.max_late);
+  }
+
+  if (wraps == 0) {
+    printf("FAIL: the run never crossed the timer wrap\n");
+    failures++;
+  }
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,36 @@
+// Generated by gen_themes.py from themes.json, do not edit
+#pragma once
+
+// Needs enum cockpit_layer and THEME_LAYER_COUNT to be defined before inclusion
+
+#define THEME_COUNT 2
+
+#define THEME_DEFAULT 0
+#define THEME_NIGHT 1
+
+// Layers each theme sets a color for; others keep the current color
+static const uint16_t PROGMEM theme_layer_mask[THEME_COUNT] = {
+    (1 << _MAC_MODE) | (1 << _WIN_MODE) | (1 << _GAME_MODE) | (1 << _MEDIA) | (1 << _NAV) | (1 << _SYM) | (1 << _NUM),
+    (1 << _MAC_MODE) | (1 << _WIN_MODE) | (1 << _GAME_MODE) | (1 << _MEDIA) | (1 << _NAV) | (1 << _SYM) | (1 << _NUM),
+};
+
+static const uint8_t PROGMEM theme_table[THEME_COUNT][THEME_LAYER_COUNT][3] = {
+    [THEME_DEFAULT] = {
+        [_MAC_MODE] = {190, 255, 200},
+        [_WIN_MODE] = {135, 255, 200},
+        [_GAME_MODE] = {0, 255, 200},
+        [_MEDIA] = {213, 255, 150},
+        [_NAV] = {43, 255, 150},
+        [_SYM] = {28, 255, 150},
+        [_NUM] = {170, 255, 150},
+    },
+    [THEME_NIGHT] = {
+        [_MAC_MODE] = {190, 255, 70},
+        [_WIN_MODE] = {135, 255, 70},
+        [_GAME_MODE] = {0, 255, 70},
+        [_MEDIA] = {213, 255, 50},
+        [_NAV] = {43, 255, 50},
+        [_SYM] = {28, 255, 50},
+        [_NUM] = {170, 255, 50},
+    },
+};
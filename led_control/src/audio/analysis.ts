@@ -0,0 +1,212 @@
+// One analysed window of audio mapped to a lighting color
+export interface AudioFrame {
+  // Wall-clock ms (timeOrigin-based) when the newest sample in the window arrived
+  arrivedAt: number;
+  // Position of the newest sample in the stream, in seconds
+  audioTime: number;
+  hue: number;
+  saturation: number;
+  value: number;
+  beat: boolean;
+  // Normalised loudness 0-1
+  energy: number;
+  // Time spent analysing this window, ms
+  analysisMs: number;
+}
+
+// In-place iterative radix-2 FFT with precomputed twiddles and bit reversal
+export class FFT {
+  private readonly cos: Float64Array;
+  private readonly sin: Float64Array;
+  private readonly rev: Uint32Array;
+
+  constructor(readonly size: number) {
+    if (size < 2 || (size & (size - 1)) !== 0) {
+      throw new Error(`FFT size must be a power of two, got ${size}`);
+    }
+
+    this.cos = new Float64Array(size / 2);
+    this.sin = new Float64Array(size / 2);
+    for (let i = 0; i < size / 2; i++) {
+      this.cos[i] = Math.cos((2 * Math.PI * i) / size);
+      this.sin[i] = -Math.sin((2 * Math.PI * i) / size);
+    }
+
+    const bits = Math.log2(size);
+    this.rev = new Uint32Array(size);
+    for (let i = 0; i < size; i++) {
+      let r = 0;
+      for (let b = 0; b < bits; b++) r |= ((i >> b) & 1) << (bits - 1 - b);
+      this.rev[i] = r;
+    }
+  }
+
+  transform(re: Float64Array, im: Float64Array) {
+    const n = this.size;
+    for (let i = 0; i < n; i++) {
+      const j = this.rev[i];
+      if (j > i) {
+        [re[i], re[j]] = [re[j], re[i]];
+        [im[i], im[j]] = [im[j], im[i]];
+      }
+    }
+
+    for (let len = 2; len <= n; len <<= 1) {
+      const half = len >> 1;
+      const step = n / len;
+      for (let start = 0; start < n; start += len) {
+        for (let k = 0; k < half; k++) {
+          const wr = this.cos[k * step];
+          const wi = this.sin[k * step];
+          const a = start + k;
+          const b = a + half;
+          const tr = re[b] * wr - im[b] * wi;
+          const ti = re[b] * wi + im[b] * wr;
+          re[b] = re[a] - tr;
+          im[b] = im[a] - ti;
+          re[a] += tr;
+          im[a] += ti;
+        }
+      }
+    }
+  }
+}
+
+/*
+ * Flags a beat when bass energy jumps well above its average over the
+ * last second, with a short refractory period so one kick is one beat.
+ */
+export class BeatDetector {
+  private readonly history: Float64Array;
+  private index = 0;
+  private filled = 0;
+  private lastBeat = -Infinity;
+
+  constructor(framesPerSecond: number, private readonly refractory = 0.12) {
+    this.history = new Float64Array(Math.max(8, Math.round(framesPerSecond)));
+  }
+
+  detect(energy: number, time: number): boolean {
+    let mean = 0;
+    for (let i = 0; i < this.filled; i++) mean += this.history[i];
+    mean = this.filled ? mean / this.filled : 0;
+
+    let variance = 0;
+    for (let i = 0; i < this.filled; i++) variance += (this.history[i] - mean) ** 2;
+    variance = this.filled ? variance / this.filled : 0;
+
+    this.history[this.index] = energy;
+    this.index = (this.index + 1) % this.history.length;
+    this.filled = Math.min(this.filled + 1, this.history.length);
+
+    // Steady material needs a bigger jump than already-spiky material
+    const threshold = mean * 1.3 + Math.sqrt(variance) * 1.5;
+    const beat = this.filled === this.history.length &&
+      energy > threshold &&
+      energy > 1e-6 &&
+      time - this.lastBeat >= this.refractory;
+
+    if (beat) this.lastBeat = time;
+    return beat;
+  }
+}
+
+const MIN_FREQ = 40;
+const MAX_FREQ = 16000;
+// Lowest bands drive beat detection
+const BASS_BANDS = 2;
+// Hue sweeps from red (bass-heavy) towards blue/purple (treble-heavy)
+const MAX_HUE = 200;
+
+/*
+ * Windowed FFT into log-spaced bands. Spectral centroid picks the hue,
+ * loudness (with automatic gain) picks the brightness and beats flash to
+ * full brightness.
+ */
+export class Analyzer {
+  private readonly fft: FFT;
+  private readonly window: Float64Array;
+  private readonly re: Float64Array;
+  private readonly im: Float64Array;
+  private readonly bandEdges: number[];
+  private readonly beats: BeatDetector;
+  private peak = 1e-4;
+  private value = 0;
+
+  constructor(readonly sampleRate: number, readonly fftSize: number, hop: number, bands = 8) {
+    if (!Number.isInteger(hop) || hop < 1 || hop > fftSize) {
+      throw new Error(`Hop must be between 1 and the FFT size (${fftSize}), got ${hop}`);
+    }
+    this.fft = new FFT(fftSize);
+    this.re = new Float64Array(fftSize);
+    this.im = new Float64Array(fftSize);
+
+    // Hann window
+    this.window = new Float64Array(fftSize);
+    for (let i = 0; i < fftSize; i++) {
+      this.window[i] = 0.5 * (1 - Math.cos((2 * Math.PI * i) / (fftSize - 1)));
+    }
+
+    const top = Math.min(MAX_FREQ, sampleRate / 2);
+    const binHz = sampleRate / fftSize;
+    this.bandEdges = [];
+    for (let b = 0; b <= bands; b++) {
+      const hz = MIN_FREQ * Math.pow(top / MIN_FREQ, b / bands);
+      this.bandEdges.push(Math.max(1, Math.round(hz / binHz)));
+    }
+
+    this.beats = new BeatDetector(sampleRate / hop);
+  }
+
+  process(samples: Float32Array, arrivedAt: number, audioTime: number): AudioFrame {
+    const started = performance.now();
+
+    for (let i = 0; i < this.fftSize; i++) {
+      this.re[i] = samples[i] * this.window[i];
+      this.im[i] = 0;
+    }
+    this.fft.transform(this.re, this.im);
+
+    const bands: number[] = [];
+    for (let b = 0; b + 1 < this.bandEdges.length; b++) {
+      const lo = this.bandEdges[b];
+      const hi = Math.max(lo + 1, this.bandEdges[b + 1]);
+      let sum = 0;
+      for (let k = lo; k < hi && k < this.fftSize / 2; k++) {
+        sum += this.re[k] * this.re[k] + this.im[k] * this.im[k];
+      }
+      bands.push(sum / (hi - lo));
+    }
+
+    const total = bands.reduce((a, e) => a + e, 0);
+    const bass = bands.slice(0, BASS_BANDS).reduce((a, e) => a + e, 0);
+    const beat = this.beats.detect(bass, audioTime);
+
+    // Centroid over bands, 0 = all bass, 1 = all treble
+    let centroid = 0;
+    if (total > 0) {
+      bands.forEach((e, i) => centroid += i * e);
+      centroid /= total * (bands.length - 1);
+    }
+
+    // Automatic gain: loudness relative to a slowly decaying peak
+    const loudness = Math.sqrt(total);
+    this.peak = Math.max(loudness, this.peak * 0.998, 1e-4);
+    const energy = Math.min(1, loudness / this.peak);
+
+    // Instant attack, smooth release, full flash on beats
+    const target = beat ? 255 : 16 + energy * 200;
+    this.value = target > this.value ? target : this.value * 0.85 + target * 0.15;
+
+    return {
+      arrivedAt,
+      audioTime,
+      hue: Math.round(centroid * MAX_HUE),
+      saturation: 255,
+      value: Math.round(this.value),
+      beat,
+      energy,
+      analysisMs: performance.now() - started
+    };
+  }
+}
@@ -0,0 +1,102 @@
+export interface PcmFormat {
+  sampleRate: number;
+  channels: number;
+  // 16 = signed 16-bit integer, 32 = 32-bit float; always little-endian
+  bits: 16 | 32;
+}
+
+const WAVE_FORMAT_PCM = 1;
+const WAVE_FORMAT_IEEE_FLOAT = 3;
+const WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+/*
+ * Turns a byte stream into mono float samples in [-1, 1]. Input is raw
+ * PCM in the given format, unless it starts with a RIFF/WAVE header, in
+ * which case the format is taken from the header.
+ */
+export class PcmDecoder {
+  private pending = Buffer.alloc(0);
+  private headerDone = false;
+  format: PcmFormat;
+
+  constructor(format: PcmFormat) {
+    this.format = format;
+  }
+
+  get bytesPerFrame() {
+    return (this.format.bits / 8) * this.format.channels;
+  }
+
+  push(chunk: Buffer): Float32Array {
+    this.pending = this.pending.length ? Buffer.concat([this.pending, chunk]) : chunk;
+
+    if (!this.headerDone) {
+      if (this.pending.length < 12) return new Float32Array(0);
+      if (this.pending.toString('ascii', 0, 4) === 'RIFF') {
+        if (!this.parseWavHeader()) return new Float32Array(0);
+      }
+      this.headerDone = true;
+    }
+
+    const frameSize = this.bytesPerFrame;
+    const frames = Math.floor(this.pending.length / frameSize);
+    const out = new Float32Array(frames);
+    const { channels, bits } = this.format;
+
+    for (let f = 0; f < frames; f++) {
+      let sum = 0;
+      for (let c = 0; c < channels; c++) {
+        const offset = f * frameSize + c * (bits / 8);
+        sum += bits === 16
+          ? this.pending.readInt16LE(offset) / 32768
+          : this.pending.readFloatLE(offset);
+      }
+      out[f] = sum / channels;
+    }
+
+    this.pending = this.pending.subarray(frames * frameSize);
+    return out;
+  }
+
+  // Returns false until the whole header up to the data chunk has arrived
+  private parseWavHeader(): boolean {
+    const buf = this.pending;
+    if (buf.toString('ascii', 8, 12) !== 'WAVE') {
+      throw new Error('Unsupported RIFF file: not WAVE');
+    }
+
+    let offset = 12;
+    while (offset + 8 <= buf.length) {
+      const id = buf.toString('ascii', offset, offset + 4);
+      const size = buf.readUInt32LE(offset + 4);
+
+      if (id === 'data') {
+        this.pending = buf.subarray(offset + 8);
+        return true;
+      }
+
+      if (offset + 8 + size > buf.length) return false;
+
+      if (id === 'fmt ') {
+        const tag = buf.readUInt16LE(offset + 8);
+        const channels = buf.readUInt16LE(offset + 10);
+        const sampleRate = buf.readUInt32LE(offset + 12);
+        const bits = buf.readUInt16LE(offset + 22);
+        // Extensible files carry the real format tag in the sub-format GUID
+        const format = tag === WAVE_FORMAT_EXTENSIBLE ? buf.readUInt16LE(offset + 32) : tag;
+
+        if (format === WAVE_FORMAT_PCM && bits === 16) {
+          this.format = { sampleRate, channels, bits: 16 };
+        } else if (format === WAVE_FORMAT_IEEE_FLOAT && bits === 32) {
+          this.format = { sampleRate, channels, bits: 32 };
+        } else {
+          throw new Error(`Unsupported WAV encoding (format ${format}, ${bits} bits); use 16-bit PCM or 32-bit float`);
+        }
+      }
+
+      // Chunks are padded to an even size
+      offset += 8 + size + (size & 1);
+    }
+    return false;
+  }
+}
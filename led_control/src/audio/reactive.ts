@@ -0,0 +1,334 @@
+import { createReadStream, createWriteStream, statSync, WriteStream } from 'fs';
+import { Readable } from 'stream';
+import { Worker } from 'worker_threads';
+import { KeyboardFleet } from '../hid/fleet.js';
+import { AudioFrame } from './analysis.js';
+import { PcmDecoder, PcmFormat } from './pcm.js';
+import type { WorkerConfig, WorkerReply } from './worker.js';
+
+export interface AudioOptions {
+  // '-' for stdin, otherwise a WAV/raw PCM file or a FIFO
+  source: string;
+  // Used for raw PCM; WAV input brings its own format
+  format: PcmFormat;
+  fftSize: number;
+  hop: number;
+  // Upper bound on colors sent per second; the device round trip lowers it further
+  maxFps: number;
+  // Simulated device round trip for dry runs, ms
+  simRttMs: number;
+  // Optional CSV of every analysed frame
+  dump?: string;
+}
+
+export interface AudioReport {
+  audioSeconds: number;
+  wallSeconds: number;
+  frames: number;
+  beats: number;
+  sent: number;
+  // Frames replaced by a newer one while a command was in flight
+  coalesced: number;
+  // Frames whose color matched the last one sent
+  unchanged: number;
+  errors: number;
+  analysisMs: { mean: number; max: number };
+  rttMs: { mean: number; max: number };
+  // Audio arrival to device acknowledgement
+  latencyMs: { mean: number; p95: number; max: number };
+  cpuPercent: number;
+  workerUtilization: number;
+}
+
+// Wall-clock ms comparable across threads (each thread has its own performance.timeOrigin)
+const now = () => performance.timeOrigin + performance.now();
+
+// Running mean/max over everything, percentiles over the most recent samples
+class Summary {
+  private static readonly RECENT = 4096;
+  private recent: number[] = [];
+  private count = 0;
+  private sum = 0;
+  max = 0;
+
+  add(v: number) {
+    this.recent[this.count % Summary.RECENT] = v;
+    this.count++;
+    this.sum += v;
+    this.max = Math.max(this.max, v);
+  }
+
+  get mean() {
+    return this.count ? this.sum / this.count : 0;
+  }
+
+  percentile(p: number) {
+    if (!this.recent.length) return 0;
+    const sorted = [...this.recent].sort((a, b) => a - b);
+    return sorted[Math.min(sorted.length - 1, Math.floor(p * sorted.length))];
+  }
+}
+
+interface Source {
+  stream: Readable;
+  // Regular files are read at playback speed; pipes and FIFOs are paced by their writer
+  paced: boolean;
+}
+
+/*
+ * In real time, files and FIFOs are read about one hop at a time: with the
+ * default 64 KiB chunks a whole burst of frames arrives at once, most get
+ * coalesced and the LEDs run ahead of the music.
+ */
+function openSource(source: string, realtime: boolean, chunkBytes: number): Source {
+  if (source === '-') return { stream: process.stdin, paced: false };
+  const isFifo = statSync(source).isFIFO();
+  const stream = realtime ? createReadStream(source, { highWaterMark: chunkBytes }) : createReadStream(source);
+  return { stream, paced: realtime && !isFifo };
+}
+
+/*
+ * Audio-reactive lighting. PCM is decoded on the main thread, analysed in
+ * a worker and the newest frame is sent to the boards. At most one color
+ * command is in flight, so the send rate follows the measured round trip
+ * and commands never pile up; frames that arrive meanwhile replace each
+ * other. Without a fleet this is an offline dry run that simulates the
+ * device round trip in audio time, which is deterministic for a given file.
+ */
+export async function runAudioMode(opts: AudioOptions, fleet?: KeyboardFleet): Promise<AudioReport> {
+  const live = fleet !== undefined;
+  const decoder = new PcmDecoder(opts.format);
+  const { stream, paced } = openSource(opts.source, live, opts.hop * decoder.bytesPerFrame);
+  const dump: WriteStream | undefined = opts.dump ? createWriteStream(opts.dump) : undefined;
+  dump?.write('time,hue,saturation,value,beat,energy\n');
+
+  const analysis = new Summary();
+  const rtt = new Summary();
+  const latency = new Summary();
+  let frames = 0, beats = 0, sent = 0, coalesced = 0, unchanged = 0, errors = 0;
+  let lastSent: [number, number, number] | null = null;
+  const minInterval = 1000 / opts.maxFps;
+
+  const started = now();
+  const cpuStart = process.cpuUsage();
+  let worker: Worker | null = null;
+  let samplesRead = 0;
+
+  // Live sending: newest frame wins, one command in flight
+  let pending: AudioFrame | null = null;
+  let inFlight: Promise<void> | null = null;
+  let lastSendAt = 0;
+  let pumpTimer: NodeJS.Timeout | null = null;
+
+  // Dry run: device busy until this audio time (s)
+  let simBusyUntil = 0;
+
+  const isUnchanged = (f: AudioFrame) =>
+    lastSent !== null && lastSent[0] === f.hue && lastSent[1] === f.saturation && lastSent[2] === f.value;
+
+  // The LEDs already show the newest color, so an older queued one must not follow it
+  const dropPending = () => {
+    if (pending) {
+      coalesced++;
+      pending = null;
+    }
+  };
+
+  const pump = () => {
+    if (!fleet || inFlight || !pending) return;
+
+    const wait = lastSendAt + minInterval - now();
+    if (wait > 0) {
+      pumpTimer ??= setTimeout(() => { pumpTimer = null; pump(); }, wait);
+      return;
+    }
+
+    const frame = pending;
+    pending = null;
+    lastSendAt = now();
+    inFlight = fleet.run(kb => kb.setRGBColor(frame.hue, frame.saturation, frame.value, false))
+      .then(results => {
+        const done = now();
+        // The slowest board bounds the fleet's round trip
+        rtt.add(Math.max(...results.map(r => r.ms)));
+        latency.add(done - frame.arrivedAt);
+        errors += results.filter(r => !r.ok).length;
+        sent++;
+        lastSent = [frame.hue, frame.saturation, frame.value];
+      })
+      .finally(() => {
+        inFlight = null;
+        pump();
+      });
+  };
+
+  const simulateSend = (frame: AudioFrame, at: number) => {
+    const busy = Math.max(opts.simRttMs, minInterval) / 1000;
+    simBusyUntil = at + busy;
+    rtt.add(opts.simRttMs);
+    latency.add((at - frame.audioTime) * 1000 + frame.analysisMs + opts.simRttMs);
+    sent++;
+    lastSent = [frame.hue, frame.saturation, frame.value];
+  };
+
+  const onFrame = (frame: AudioFrame) => {
+    frames++;
+    if (frame.beat) beats++;
+    analysis.add(frame.analysisMs);
+    dump?.write(`${frame.audioTime.toFixed(4)},${frame.hue},${frame.saturation},${frame.value},${frame.beat ? 1 : 0},${frame.energy.toFixed(4)}\n`);
+
+    if (live) {
+      if (isUnchanged(frame)) { unchanged++; dropPending(); return; }
+      if (pending) coalesced++;
+      pending = frame;
+      pump();
+      return;
+    }
+
+    if (pending && simBusyUntil <= frame.audioTime) {
+      const queued = pending;
+      pending = null;
+      simulateSend(queued, Math.max(simBusyUntil, queued.audioTime));
+    }
+    if (isUnchanged(frame)) { unchanged++; dropPending(); return; }
+    if (simBusyUntil <= frame.audioTime) {
+      simulateSend(frame, frame.audioTime);
+    } else {
+      if (pending) coalesced++;
+      pending = frame;
+    }
+  };
+
+  // Settles only if the worker throws or exits on its own; raced against every wait below
+  let workerFailed: (error: Error) => void = () => {};
+  const failure = new Promise<never>((_, reject) => { workerFailed = reject; });
+  failure.catch(() => {});
+  let workerDone = false;
+
+  const ensureWorker = () => {
+    if (worker) return worker;
+    const config: WorkerConfig = { sampleRate: decoder.format.sampleRate, fftSize: opts.fftSize, hop: opts.hop };
+    worker = new Worker(new URL('./worker.js', import.meta.url), { workerData: config });
+    worker.on('message', (msg: WorkerReply) => {
+      if (msg.type === 'frame') onFrame(msg.frame);
+    });
+    worker.on('error', error => workerFailed(new Error(`Audio analysis failed: ${error.message}`)));
+    worker.on('exit', code => {
+      if (!workerDone) workerFailed(new Error(`Audio analysis stopped unexpectedly (exit code ${code})`));
+    });
+    return worker;
+  };
+
+  const status = live ? setInterval(() => {
+    process.stderr.write(
+      `\r${frames} frames, ${beats} beats, ${sent} sent, rtt ${rtt.mean.toFixed(1)} ms, ` +
+      `latency ${latency.mean.toFixed(1)} ms (p95 ${latency.percentile(0.95).toFixed(1)})   `
+    );
+  }, 1000) : null;
+
+  const stop = () => stream.destroy();
+  process.once('SIGINT', stop);
+
+  const streamDone = new Promise<void>((resolve, reject) => {
+    stream.on('data', (chunk: Buffer) => {
+      const readAt = now();
+      const samples = decoder.push(chunk);
+      if (samples.length === 0) return;
+
+      samplesRead += samples.length;
+      // A paced file is "heard" at its playback position, which can be a little after it was read
+      const arrivedAt = paced
+        ? Math.max(readAt, started + (samplesRead / decoder.format.sampleRate) * 1000)
+        : readAt;
+      ensureWorker().postMessage({ type: 'samples', samples, arrivedAt }, [samples.buffer as ArrayBuffer]);
+
+      if (paced) {
+        // Hold back until the wall clock catches up with the audio read so far
+        const ahead = (samplesRead / decoder.format.sampleRate) * 1000 - (now() - started);
+        if (ahead > 5) {
+          stream.pause();
+          setTimeout(() => stream.resume(), ahead);
+        }
+      }
+    });
+    stream.on('error', reject);
+    stream.once('end', resolve);
+    stream.once('close', resolve);
+  });
+
+  // State below is mutated from callbacks, so read it without the narrowing from its declarations
+  const activeWorker = () => worker as Worker | null;
+  let workerUtilization = 0;
+
+  try {
+    await Promise.race([streamDone, failure]);
+
+    // Let the worker drain everything already posted
+    const drainWorker = activeWorker();
+    if (drainWorker) {
+      await Promise.race([failure, new Promise<void>(resolve => {
+        drainWorker.on('message', (msg: WorkerReply) => { if (msg.type === 'end') resolve(); });
+        drainWorker.postMessage({ type: 'end' });
+      })]);
+    }
+
+    const leftover = pending as AudioFrame | null;
+    if (live) {
+      pending = null;
+      await (inFlight as Promise<void> | null);
+    } else if (leftover) {
+      simulateSend(leftover, Math.max(simBusyUntil, leftover.audioTime));
+    }
+  } finally {
+    // Also runs when the source or the worker failed, so nothing keeps the process alive
+    process.removeListener('SIGINT', stop);
+    stream.destroy();
+    const timer = pumpTimer as NodeJS.Timeout | null;
+    if (timer) clearTimeout(timer);
+    pending = null;
+    if (status) {
+      clearInterval(status);
+      process.stderr.write('\n');
+    }
+
+    const finalWorker = activeWorker();
+    workerDone = true;
+    if (finalWorker) {
+      workerUtilization = finalWorker.performance.eventLoopUtilization().utilization;
+      await finalWorker.terminate();
+    }
+    await new Promise<void>(resolve => dump ? dump.end(resolve) : resolve());
+  }
+
+  const wallMs = now() - started;
+  const cpu = process.cpuUsage(cpuStart);
+
+  return {
+    audioSeconds: samplesRead / decoder.format.sampleRate,
+    wallSeconds: wallMs / 1000,
+    frames,
+    beats,
+    sent,
+    coalesced,
+    unchanged,
+    errors,
+    analysisMs: { mean: analysis.mean, max: analysis.max },
+    rttMs: { mean: rtt.mean, max: rtt.max },
+    latencyMs: { mean: latency.mean, p95: latency.percentile(0.95), max: latency.max },
+    cpuPercent: ((cpu.user + cpu.system) / 1000 / wallMs) * 100,
+    workerUtilization
+  };
+}
+
+export function formatAudioReport(report: AudioReport): string {
+  const ms = (v: number) => `${v.toFixed(2)} ms`;
+  return [
+    `Audio        ${report.audioSeconds.toFixed(2)} s in ${report.wallSeconds.toFixed(2)} s`,
+    `Frames       ${report.frames} analysed, ${report.beats} beats`,
+    `Commands     ${report.sent} sent, ${report.coalesced} coalesced, ${report.unchanged} unchanged, ${report.errors} errors`,
+    `Analysis     mean ${ms(report.analysisMs.mean)}, max ${ms(report.analysisMs.max)}`,
+    `Round trip   mean ${ms(report.rttMs.mean)}, max ${ms(report.rttMs.max)}`,
+    `Latency      mean ${ms(report.latencyMs.mean)}, p95 ${ms(report.latencyMs.p95)}, max ${ms(report.latencyMs.max)} (audio in to LED ack)`,
+    `CPU          ${report.cpuPercent.toFixed(1)}% of one core, worker ${(report.workerUtilization * 100).toFixed(1)}% busy`,
+  ].join('\n');
+}
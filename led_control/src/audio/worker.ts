@@ -0,0 +1,52 @@
+import { parentPort, workerData } from 'worker_threads';
+import { Analyzer, AudioFrame } from './analysis.js';
+
+export interface WorkerConfig {
+  sampleRate: number;
+  fftSize: number;
+  hop: number;
+}
+
+export type WorkerRequest =
+  // arrivedAt: wall-clock ms at which the last sample of the chunk was available
+  | { type: 'samples'; samples: Float32Array; arrivedAt: number }
+  | { type: 'end' };
+
+export type WorkerReply =
+  | { type: 'frame'; frame: AudioFrame }
+  | { type: 'end' };
+
+const { sampleRate, fftSize, hop } = workerData as WorkerConfig;
+const analyzer = new Analyzer(sampleRate, fftSize, hop);
+
+// Sliding analysis window; a frame is produced every hop samples
+const frameWindow = new Float32Array(fftSize);
+let sinceFrame = 0;
+let totalSamples = 0;
+
+parentPort!.on('message', (msg: WorkerRequest) => {
+  if (msg.type === 'end') {
+    parentPort!.postMessage({ type: 'end' } satisfies WorkerReply);
+    return;
+  }
+
+  const { samples, arrivedAt } = msg;
+  // Frames that end before the chunk does were available that much earlier
+  const chunkEnd = totalSamples + samples.length;
+  let offset = 0;
+  while (offset < samples.length) {
+    const take = Math.min(hop - sinceFrame, samples.length - offset);
+    frameWindow.copyWithin(0, take);
+    frameWindow.set(samples.subarray(offset, offset + take), fftSize - take);
+    offset += take;
+    sinceFrame += take;
+    totalSamples += take;
+
+    if (sinceFrame === hop) {
+      sinceFrame = 0;
+      const frameArrivedAt = arrivedAt - ((chunkEnd - totalSamples) / sampleRate) * 1000;
+      const frame = analyzer.process(frameWindow, frameArrivedAt, totalSamples / sampleRate);
+      parentPort!.postMessage({ type: 'frame', frame } satisfies WorkerReply);
+    }
+  }
+});
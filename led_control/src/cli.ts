@@ -1,44 +1,335 @@
 #!/usr/bin/env node
 import { Command } from 'commander';
-import { KeyboardHID } from './hid/keyboard.js';
+import { readFileSync, statSync } from 'fs';
+import { KeyboardHID, IDLE_STAGES, IdleTimeouts, THEME_LAYERS, CustomTheme } from './hid/keyboard.js';
+import { KeyboardFleet, BoardResult, boardLabel } from './hid/fleet.js';
+import { parseSymbols, formatMemReport } from './mem.js';
+import { runAudioMode, formatAudioReport, AudioOptions, AudioReport } from './audio/reactive.js';
 
 const program = new Command();
 
+// Bad command-line input; reported without the connection hints
+class UsageError extends Error {}
+
+function fail(error: unknown): never {
+  console.error('Error:', error instanceof Error ? error.message : 'Unknown error');
+  if (error instanceof UsageError) process.exit(1);
+  console.error('Please ensure:');
+  console.error('1. The keyboard is properly connected');
+  console.error('2. You have the necessary permissions to access HID devices');
+  console.error('3. The keyboard firmware supports Raw HID communication');
+  process.exit(1);
+}
+
+// Without --board or --all only the first board found is addressed, as before
+function openFleet(): KeyboardFleet {
+  const opts = program.opts();
+  if (opts.all) return new KeyboardFleet();
+  if (opts.board) return new KeyboardFleet(opts.board);
+
+  const boards = KeyboardHID.list();
+  if (boards.length === 0) throw new Error('Keyboard connection failed: No Raw HID interface found');
+  return new KeyboardFleet([boards[0].path], boards);
+}
+
+// Parses a whole number within [min, max], rejecting anything else instead of sending NaN
+function parseIntOption(value: string, name: string, min: number, max: number): number {
+  const n = Number(value);
+  if (value.trim() === '' || !Number.isInteger(n) || n < min || n > max) {
+    throw new UsageError(`${name} must be a whole number from ${min} to ${max}, got '${value}'`);
+  }
+  return n;
+}
+
+function parseIdleTimeouts(value: string): IdleTimeouts {
+  const parts = value.split(',');
+  if (parts.length !== 3) {
+    throw new UsageError(`--idle-timeouts needs exactly three values (dim,freeze,off), got '${value}'`);
+  }
+  const [dim, freeze, off] = parts.map(p => parseIntOption(p, '--idle-timeouts', 0, 65535));
+  return { dim, freeze, off };
+}
+
+// Reads a custom theme: one theme entry in the themes.json format, or just its layers object
+function loadCustomTheme(file: string): CustomTheme {
+  let json: any;
+  try {
+    json = JSON.parse(readFileSync(file, 'utf8'));
+  } catch (e) {
+    throw new UsageError(`Cannot read custom theme ${file}: ${e instanceof Error ? e.message : e}`);
+  }
+
+  const layers = json?.layers ?? json;
+  if (typeof layers !== 'object' || layers === null || Array.isArray(layers)) {
+    throw new UsageError(`${file}: expected an object mapping layer names to [hue, sat, val]`);
+  }
+
+  const theme: CustomTheme = {};
+  for (const [name, hsv] of Object.entries(layers)) {
+    const layer = THEME_LAYERS.find(l => l === name);
+    if (!layer) {
+      throw new UsageError(`${file}: unknown layer "${name}" (expected one of ${THEME_LAYERS.join(', ')})`);
+    }
+    if (!Array.isArray(hsv) || hsv.length !== 3 || !hsv.every(c => Number.isInteger(c) && c >= 0 && c <= 255)) {
+      throw new UsageError(`${file}: ${name} must be [hue, sat, val] in 0-255`);
+    }
+    theme[layer] = hsv as [number, number, number];
+  }
+  return theme;
+}
+
+// Prints one line per board and returns false if any board failed
+function report<T>(results: BoardResult<T>[], format: (value: T) => string): boolean {
+  const multi = results.length > 1;
+  for (const result of results) {
+    const prefix = multi ? `${boardLabel(result.board)}: ` : '';
+    if (result.ok) {
+      console.log(`${prefix}${format(result.value)}${multi ? ` (${result.ms.toFixed(1)} ms)` : ''}`);
+    } else {
+      console.error(`${prefix}Error: ${result.error}`);
+    }
+  }
+  return results.every(r => r.ok);
+}
+
 program
   .name('led-control')
   .description('Control keyboard LED settings')
   .option('-i, --interactive', 'Start interactive UI mode')
+  .option('-b, --board <serial|path>', 'Address a board by serial number or device path (repeatable)',
+    (id: string, ids: string[] = []) => [...ids, id])
+  .option('--all', 'Address every attached board')
   .option('-s, --skadis <on|off>', 'Set Skadis mode')
   .option('-w, --white <on|off>', 'Set white mode')
   .option('-e, --effect <number>', 'Set RGB effect (0-10)')
   .option('-c, --color <h,s,v>', 'Set RGB color (0-255,0-255,0-255)')
   .option('-a, --animation-speed <number>', 'Set animation speed (0-255)')
-  .parse();
-
-const opts = program.opts();
-
-try {
-  const keyboard = new KeyboardHID();
-  
-  if (opts.interactive) {
-    import('./ui.js').then(ui => ui.startUI());
-  } else {
-    if (opts.skadis) keyboard.setSkadisMode(opts.skadis === 'on');
-    if (opts.white) keyboard.setWhiteMode(opts.white === 'on');
-    if (opts.effect) keyboard.setRGBEffect(parseInt(opts.effect));
-    if (opts.color) {
-      const [h, s, v] = opts.color.split(',').map(Number);
-      console.log(`Setting color to HSV(${h}, ${s}, ${v})`);
-      keyboard.setRGBColor(h, s, v);
-    }
-    if (opts.animationSpeed) keyboard.setAnimationSpeed(parseInt(opts.animationSpeed));
-    process.exit(0);
-  }
-} catch (error) {
-  console.error('Error:', error instanceof Error ? error.message : 'Unknown error');
-  console.error('Please ensure:');
-  console.error('1. The keyboard is properly connected');
-  console.error('2. You have the necessary permissions to access HID devices');
-  console.error('3. The keyboard firmware supports Raw HID communication');
-  process.exit(1);
-} 
\ No newline at end of file
+  .option('-t, --theme <index>', 'Switch the layer color theme (see themes.json in the keymap)')
+  .option('--save-theme', 'Keep the theme selected with --theme across reboots')
+  .option('--custom-theme <file>', 'Store a custom theme (JSON, themes.json format) in EEPROM; select it with --theme')
+  .option('--clear-custom-theme', 'Erase the stored custom theme')
+  .option('--idle-timeouts <dim,freeze,off>', 'Set idle thresholds in seconds (0 disables a stage)')
+  .action(async () => {
+    const opts = program.opts();
+
+    try {
+      if (opts.interactive) {
+        // The interactive UI drives a single board
+        const id: string | undefined = opts.board?.[0];
+        const board = id ? KeyboardHID.list().find(b => b.serialNumber === id || b.path === id) : undefined;
+        if (id && !board) throw new Error(`Keyboard connection failed: No keyboard matches ${id}`);
+        import('./ui.js').then(ui => ui.startUI(board ? { info: board } : {}));
+        return;
+      }
+
+      // Validate before any board is touched
+      const idleTimeouts = opts.idleTimeouts ? parseIdleTimeouts(opts.idleTimeouts) : undefined;
+      const customTheme = opts.customTheme ? loadCustomTheme(opts.customTheme) : undefined;
+
+      const fleet = openFleet();
+      let ok = true;
+
+      // Each step runs on all boards in parallel; steps stay in order per board
+      if (opts.skadis) {
+        ok = report(await fleet.run(kb => kb.setSkadisMode(opts.skadis === 'on')),
+          on => `Skadis mode ${on ? 'on' : 'off'}`) && ok;
+      }
+      if (opts.white) {
+        ok = report(await fleet.run(kb => kb.setWhiteMode(opts.white === 'on')),
+          on => `White mode ${on ? 'on' : 'off'}`) && ok;
+      }
+      if (opts.effect) {
+        ok = report(await fleet.run(kb => kb.setRGBEffect(parseInt(opts.effect))),
+          mode => `Effect ${mode}`) && ok;
+      }
+      if (opts.color) {
+        const [h, s, v] = opts.color.split(',').map(Number);
+        console.log(`Setting color to HSV(${h}, ${s}, ${v})`);
+        ok = report(await fleet.run(kb => kb.setRGBColor(h, s, v)),
+          c => `HSV(${c.hue}, ${c.saturation}, ${c.value})`) && ok;
+      }
+      if (opts.animationSpeed) {
+        ok = report(await fleet.run(kb => kb.setAnimationSpeed(parseInt(opts.animationSpeed))),
+          speed => `Animation speed ${speed}`) && ok;
+      }
+      // Stored before --theme so both can be given at once
+      if (customTheme || opts.clearCustomTheme) {
+        ok = report(await fleet.run(kb => kb.setCustomTheme(customTheme ?? null)),
+          t => t.stored ? `Custom theme stored as theme ${t.theme}` : 'Custom theme erased') && ok;
+      }
+      if (opts.theme) {
+        ok = report(await fleet.run(kb => kb.setTheme(parseInt(opts.theme), Boolean(opts.saveTheme))),
+          t => `Theme ${t.theme} of ${t.count}`) && ok;
+      }
+      if (idleTimeouts) {
+        ok = report(await fleet.run(kb => kb.setIdleTimeouts(idleTimeouts)),
+          t => `Idle thresholds: dim ${t.dim}s, freeze ${t.freeze}s, off ${t.off}s`) && ok;
+      }
+
+      await fleet.close();
+      process.exit(ok ? 0 : 1);
+    } catch (error) {
+      fail(error);
+    }
+  });
+
+program
+  .command('list')
+  .description('List attached boards with their serial numbers and paths')
+  .action(() => {
+    const boards = KeyboardHID.list();
+    if (boards.length === 0) {
+      console.log('No boards found');
+    }
+    for (const board of boards) {
+      console.log(`${board.serialNumber ?? '(no serial)'}\t${board.path}\t${board.product ?? ''}`);
+    }
+  });
+
+program
+  .command('idle')
+  .description('Report the idle LED stage and time spent in each stage')
+  .action(async () => {
+    try {
+      const fleet = openFleet();
+      const ok = report(await fleet.run(kb => kb.getIdleStats()), stats => [
+        `Stage ${stats.stage} (dim after ${stats.timeouts.dim}s, freeze after ${stats.timeouts.freeze}s, off after ${stats.timeouts.off}s)`,
+        ...IDLE_STAGES.map(stage => `  ${stage.padEnd(8)} ${String(stats.seconds[stage]).padStart(8)} s`)
+      ].join('\n'));
+      await fleet.close();
+      process.exit(ok ? 0 : 1);
+    } catch (error) {
+      fail(error);
+    }
+  });
+
+program
+  .command('sched')
+  .description('Report firmware timer scheduler accuracy')
+  .action(async () => {
+    try {
+      const fleet = openFleet();
+      const ok = report(await fleet.run(kb => kb.getSchedStats()), stats => [
+        `${stats.pending} timers pending`,
+        ...stats.timers.map(t => {
+          const mean = t.dispatches ? t.totalLateMs / t.dispatches : 0;
+          return `  ${t.name.padEnd(14)} ${String(t.dispatches).padStart(8)} runs, lateness mean ${mean.toFixed(2)} ms, max ${t.maxLateMs} ms`;
+        })
+      ].join('\n'));
+      await fleet.close();
+      process.exit(ok ? 0 : 1);
+    } catch (error) {
+      fail(error);
+    }
+  });
+
+program
+  .command('mem')
+  .description('Report firmware SRAM usage and stack high-water mark')
+  .option('--symbols <file>', 'Firmware .elf (needs avr-nm) or saved `avr-nm -S -l` output, for a per-feature .data/.bss breakdown')
+  .action(async (cmdOpts: { symbols?: string }) => {
+    try {
+      const fleet = openFleet();
+      const features = cmdOpts.symbols ? parseSymbols(cmdOpts.symbols) : undefined;
+      const ok = report(await fleet.run(kb => kb.getMemStats()),
+        stats => formatMemReport(stats, features));
+      await fleet.close();
+      process.exit(ok ? 0 : 1);
+    } catch (error) {
+      fail(error);
+    }
+  });
+
+program
+  .command('audio')
+  .description('Drive the lighting from audio (PCM or WAV from a file, FIFO or - for stdin)')
+  .argument('<source>', 'Audio source; raw PCM uses --rate/--channels/--float, WAV files bring their own format')
+  .option('-r, --rate <hz>', 'Raw PCM sample rate', '48000')
+  .option('--channels <count>', 'Raw PCM channel count', '2')
+  .option('--float', 'Raw PCM is 32-bit float instead of signed 16-bit')
+  .option('--fft-size <samples>', 'Analysis window, a power of two', '1024')
+  .option('--hop <samples>', 'Samples between analysed frames', '512')
+  .option('--max-fps <count>', 'Upper bound on colors sent per second', '60')
+  .option('--dry-run', 'Analyse without a keyboard, simulating the device round trip')
+  .option('--sim-rtt <ms>', 'Round trip assumed by --dry-run', '4')
+  .option('--dump <file>', 'Write every analysed frame to a CSV file')
+  .action(async (source: string, cmdOpts: {
+    rate: string; channels: string; float?: boolean; fftSize: string; hop: string;
+    maxFps: string; dryRun?: boolean; simRtt: string; dump?: string;
+  }) => {
+    try {
+      // Everything is checked before any board is switched to audio mode
+      const fftSize = parseIntOption(cmdOpts.fftSize, '--fft-size', 64, 16384);
+      if ((fftSize & (fftSize - 1)) !== 0) {
+        throw new UsageError(`--fft-size must be a power of two, got ${fftSize}`);
+      }
+      const maxFps = Number(cmdOpts.maxFps);
+      const simRttMs = Number(cmdOpts.simRtt);
+      if (!(maxFps > 0 && maxFps <= 1000)) {
+        throw new UsageError(`--max-fps must be above 0 and at most 1000, got '${cmdOpts.maxFps}'`);
+      }
+      if (!(simRttMs >= 0 && simRttMs <= 1000)) {
+        throw new UsageError(`--sim-rtt must be from 0 to 1000 ms, got '${cmdOpts.simRtt}'`);
+      }
+      if (source !== '-') {
+        try {
+          statSync(source);
+        } catch (e) {
+          throw new UsageError(`Cannot open audio source ${source}: ${e instanceof Error ? e.message : e}`);
+        }
+      }
+
+      const opts: AudioOptions = {
+        source,
+        format: {
+          sampleRate: parseIntOption(cmdOpts.rate, '--rate', 8000, 192000),
+          channels: parseIntOption(cmdOpts.channels, '--channels', 1, 8),
+          bits: cmdOpts.float ? 32 : 16
+        },
+        fftSize,
+        hop: parseIntOption(cmdOpts.hop, '--hop', 1, fftSize),
+        maxFps,
+        simRttMs,
+        dump: cmdOpts.dump
+      };
+
+      if (cmdOpts.dryRun) {
+        console.log(formatAudioReport(await runAudioMode(opts)));
+        process.exit(0);
+      }
+
+      const fleet = openFleet();
+      // Color commands only apply in Skadis mode; remember each board's lighting to put it back afterwards
+      const saved = await fleet.run(kb => kb.getCurrentState());
+      if (!report(saved, () => 'Audio mode started')) {
+        await fleet.close();
+        process.exit(1);
+      }
+
+      let result: AudioReport;
+      try {
+        await fleet.run(async kb => {
+          await kb.setSkadisMode(true);
+          await kb.setRGBEffect(1);
+        });
+        result = await runAudioMode(opts, fleet);
+      } finally {
+        // Color first without EEPROM, then the effect, whose EEPROM write then stores the restored color
+        report(await fleet.run(async kb => {
+          const state = saved[fleet.keyboards.indexOf(kb)];
+          if (!state.ok) return;
+          await kb.setRGBColor(state.value.hue, state.value.saturation, state.value.value, false);
+          await kb.setRGBEffect(state.value.mode);
+          await kb.setSkadisMode(state.value.skadisMode);
+        }), () => 'Lighting restored');
+        await fleet.close();
+      }
+
+      console.log(formatAudioReport(result));
+      process.exit(result.errors === 0 ? 0 : 1);
+    } catch (error) {
+      fail(error);
+    }
+  });
+
+program.parse();
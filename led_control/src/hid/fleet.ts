@@ -0,0 +1,58 @@
+import { KeyboardHID, KeyboardInfo } from './keyboard.js';
+
+export type BoardResult<T> =
+  | { board: KeyboardInfo; ok: true; value: T; ms: number }
+  | { board: KeyboardInfo; ok: false; error: string; ms: number };
+
+// Short name for a board in reports: serial number when the firmware has one, else the path
+export function boardLabel(board: KeyboardInfo): string {
+  return board.serialNumber || board.path;
+}
+
+/*
+ * A set of boards driven together. Each board has its own command queue,
+ * so a command dispatched to the fleet costs about one round trip no
+ * matter how many boards are attached.
+ */
+export class KeyboardFleet {
+  readonly keyboards: KeyboardHID[];
+
+  /*
+   * @param ids     Serial numbers or device paths to address; empty means every board found
+   * @param boards  Result of KeyboardHID.list() if the caller already has one; the bus is
+   *                enumerated once per fleet, as enumeration is slow on Windows and macOS
+   */
+  constructor(ids: string[] = [], boards: KeyboardInfo[] = KeyboardHID.list()) {
+    if (boards.length === 0) {
+      throw new Error('Keyboard connection failed: No Raw HID interface found');
+    }
+
+    const unknown = ids.filter(id => !boards.some(b => b.serialNumber === id || b.path === id));
+    if (unknown.length > 0) {
+      throw new Error(`Keyboard connection failed: No keyboard matches ${unknown.join(', ')}`);
+    }
+
+    const selected = ids.length === 0
+      ? boards
+      : boards.filter(b => ids.includes(b.path) || (b.serialNumber !== undefined && ids.includes(b.serialNumber)));
+    this.keyboards = selected.map(b => new KeyboardHID({ info: b }));
+  }
+
+  // Runs fn on every board concurrently; one board failing does not stop the others
+  async run<T>(fn: (keyboard: KeyboardHID) => Promise<T>): Promise<BoardResult<T>[]> {
+    return Promise.all(this.keyboards.map(async (keyboard): Promise<BoardResult<T>> => {
+      const started = performance.now();
+      try {
+        const value = await fn(keyboard);
+        return { board: keyboard.info, ok: true, value, ms: performance.now() - started };
+      } catch (e: unknown) {
+        const error = e instanceof Error ? e.message : 'Unknown error';
+        return { board: keyboard.info, ok: false, error, ms: performance.now() - started };
+      }
+    }));
+  }
+
+  async close() {
+    await Promise.all(this.keyboards.map(keyboard => keyboard.close()));
+  }
+}
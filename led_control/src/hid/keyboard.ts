@@ -6,6 +6,54 @@ export interface Version {
   patch: number;
 }
 
+// SRAM usage reported by the firmware, all values in bytes
+export interface MemStats {
+  ramSize: number;
+  dataSize: number;
+  bssSize: number;
+  stackSize: number;
+  stackPeak: number;
+  stackNow: number;
+}
+
+// Idle thresholds in seconds since the last key or encoder event; 0 disables a stage
+export interface IdleTimeouts {
+  dim: number;
+  freeze: number;
+  off: number;
+}
+
+export const IDLE_STAGES = ['active', 'dim', 'frozen', 'off'] as const;
+export type IdleStage = typeof IDLE_STAGES[number];
+
+// Must match enum cockpit_layer in keymap.c; a custom theme maps these names to colors
+export const THEME_LAYERS = ['_MAC_MODE', '_WIN_MODE', '_GAME_MODE', '_MEDIA', '_NAV', '_SYM', '_NUM', '_ADJUST'] as const;
+export type ThemeLayer = typeof THEME_LAYERS[number];
+export type CustomTheme = Partial<Record<ThemeLayer, [number, number, number]>>;
+
+export interface IdleStats {
+  stage: IdleStage;
+  timeouts: IdleTimeouts;
+  // Whole seconds spent in each stage since the keyboard booted
+  seconds: Record<IdleStage, number>;
+}
+
+// Must match sched_timer_id_t in sched.h; timers beyond this list are reported by index
+export const SCHED_TIMERS = ['app switcher', 'idle governor', 'stack scan'];
+
+// Dispatch accuracy of one firmware timer; lateness is measured against its deadline
+export interface SchedTimerStats {
+  name: string;
+  dispatches: number;
+  totalLateMs: number;
+  maxLateMs: number;
+}
+
+export interface SchedStats {
+  timers: SchedTimerStats[];
+  pending: number;
+}
+
 enum LogLevel {
   NONE = 0,
   ERROR = 1,
@@ -13,12 +61,34 @@ enum LogLevel {
   DEBUG = 3
 }
 
+// A matching Raw HID interface, as found during enumeration
+export interface KeyboardInfo {
+  path: string;
+  serialNumber?: string;
+  product?: string;
+  manufacturer?: string;
+}
+
+// Picks one board by serial number or device path; empty picks the first one found
+export interface KeyboardSelector {
+  serial?: string;
+  path?: string;
+  // A board already found by list(); used as is, without enumerating the bus again
+  info?: KeyboardInfo;
+}
+
 export class KeyboardHID {
-  private device: HID.HID | null = null;
+  private device: HID.HIDAsync | null = null;
+  private opening: Promise<HID.HIDAsync> | null = null;
+  // Commands share one interrupt endpoint, so each waits for the previous response
+  private queue: Promise<unknown> = Promise.resolve();
+  readonly info: KeyboardInfo;
   
   // Command constants
   private static readonly VID = 0x4648;
   private static readonly PID = 0x0001;
+  private static readonly USAGE_PAGE = 0xFF60;
+  private static readonly USAGE = 0x61;
   private static readonly REPORT_SIZE = 33;
   private static readonly CMD_SKADIS_MODE = 0x01;
   private static readonly CMD_WHITE_MODE = 0x02;
@@ -26,20 +96,29 @@ export class KeyboardHID {
   private static readonly CMD_RGB_COLOR = 0x04;
   private static readonly CMD_ANIMATION_SPEED = 0x05;
   private static readonly CMD_SET_DIRECTION = 0x06;
+  private static readonly CMD_GET_MEM_STATS = 0x07;
+  private static readonly CMD_SET_IDLE_TIMEOUTS = 0x08;
+  private static readonly CMD_GET_IDLE_STATS = 0x09;
+  private static readonly CMD_SET_THEME = 0x0A;
+  private static readonly CMD_GET_SCHED_STATS = 0x0B;
+  private static readonly CMD_SET_CUSTOM_THEME = 0x0C;
   private static readonly CMD_GET_VERSION = 0x0E;
   private static readonly CMD_GET_STATE = 0x0F;
 
-  private static logLevel = LogLevel.NONE;
+  // Can be set via environment variable: LOGLEVEL=none|error|info|debug
+  // Read once here so static helpers like list() honour it before any board is opened
+  private static logLevel = KeyboardHID.logLevelFromEnv();
 
-  constructor() {
-    // Can be set via environment variable: LOGLEVEL=none|error|info|debug
+  private static logLevelFromEnv(): LogLevel {
     const level = process.env.LOGLEVEL?.toLowerCase();
-    if (level === 'none') KeyboardHID.logLevel = LogLevel.NONE;
-    if (level === 'error') KeyboardHID.logLevel = LogLevel.ERROR;
-    if (level === 'info') KeyboardHID.logLevel = LogLevel.INFO;
-    if (level === 'debug') KeyboardHID.logLevel = LogLevel.DEBUG;
-    
-    this.connect();
+    if (level === 'error') return LogLevel.ERROR;
+    if (level === 'info') return LogLevel.INFO;
+    if (level === 'debug') return LogLevel.DEBUG;
+    return LogLevel.NONE;
+  }
+
+  constructor(selector: KeyboardSelector = {}) {
+    this.info = selector.info ?? KeyboardHID.select(selector);
   }
 
   private log(level: LogLevel, ...args: any[]) {
@@ -50,39 +129,45 @@ export class KeyboardHID {
     }
   }
 
-  private connect() {
-    try {
-      const allDevices = HID.devices();
-      this.log(LogLevel.DEBUG, 'Available HID devices:', allDevices);
+  // Lists every attached board exposing the Raw HID interface
+  static list(): KeyboardInfo[] {
+    const allDevices = HID.devices();
+    if (KeyboardHID.logLevel >= LogLevel.DEBUG) {
+      console.log('🔍', 'Available HID devices:', allDevices);
+    }
 
-      // Filter for Raw HID interface
-      const devices = allDevices.filter(d => 
-        d.vendorId === KeyboardHID.VID && 
+    return allDevices
+      .filter(d =>
+        d.vendorId === KeyboardHID.VID &&
         d.productId === KeyboardHID.PID &&
-        d.usagePage === 0xFF60 && // 65376 in decimal
-        d.usage === 0x61        // 97 in decimal
-      );
-      this.log(LogLevel.DEBUG, 'Filtered keyboard devices:', devices);
+        d.usagePage === KeyboardHID.USAGE_PAGE && // 65376 in decimal
+        d.usage === KeyboardHID.USAGE &&          // 97 in decimal
+        d.path !== undefined
+      )
+      .map(d => ({
+        path: d.path!,
+        serialNumber: d.serialNumber || undefined,
+        product: d.product,
+        manufacturer: d.manufacturer
+      }));
+  }
 
+  private static select(selector: KeyboardSelector): KeyboardInfo {
+    try {
+      const devices = KeyboardHID.list();
       if (devices.length === 0) {
         throw new Error('No Raw HID interface found');
       }
 
-      const devicePath = devices[0].path;
-      if (!devicePath) {
-        throw new Error('Device path is undefined');
-      }
-
-      try {
-        this.device = new HID.HID(devicePath);
-        this.log(LogLevel.INFO, 'Successfully connected to keyboard');
-      } catch (e: unknown) {
-        this.log(LogLevel.ERROR, 'Failed to open HID device:', e);
-        throw new Error(`Failed to open HID device: ${e instanceof Error ? e.message : 'Unknown error'}`);
+      const match = devices.find(d =>
+        (selector.path === undefined || d.path === selector.path) &&
+        (selector.serial === undefined || d.serialNumber === selector.serial)
+      );
+      if (!match) {
+        throw new Error(`No keyboard matches ${selector.serial ?? selector.path}`);
       }
-
+      return match;
     } catch (e: unknown) {
-      this.log(LogLevel.ERROR, 'Failed to connect:', e);
       if (e instanceof Error) {
         throw new Error(`Keyboard connection failed: ${e.message}`);
       }
@@ -90,20 +175,47 @@ export class KeyboardHID {
     }
   }
 
-  private async sendCommandWithResponse(cmd: number, ...args: number[]): Promise<number[]> {
-    if (!this.device) {
-      throw new Error('No device connected');
+  private async connect(): Promise<HID.HIDAsync> {
+    if (this.device) return this.device;
+    if (!this.opening) {
+      this.opening = HID.HIDAsync.open(this.info.path)
+        .then(device => {
+          this.device = device;
+          this.log(LogLevel.INFO, `Successfully connected to keyboard ${this.info.path}`);
+          return device;
+        })
+        .catch((e: unknown) => {
+          this.log(LogLevel.ERROR, 'Failed to open HID device:', e);
+          throw new Error(`Failed to open HID device: ${e instanceof Error ? e.message : 'Unknown error'}`);
+        })
+        .finally(() => {
+          this.opening = null;
+        });
     }
+    return this.opening;
+  }
+
+  private sendCommandWithResponse(cmd: number, ...args: number[]): Promise<number[]> {
+    const result = this.queue.then(() => this.transfer(cmd, args));
+    this.queue = result.catch(() => undefined);
+    return result;
+  }
 
+  private async transfer(cmd: number, args: number[]): Promise<number[]> {
     try {
+      const device = await this.connect();
       const report = new Array(KeyboardHID.REPORT_SIZE).fill(0);
       report[1] = cmd;
       args.forEach((arg, i) => report[i + 2] = arg);
 
       this.log(LogLevel.INFO, `📤 CMD ${cmd}:`, args);
-      this.device.write(report);
+      await device.write(report);
       
-      const response = await this.device.readTimeout(1000);
+      const data = await device.read(1000);
+      if (!data || data.length === 0) {
+        throw new Error('Timed out waiting for response');
+      }
+      const response = Array.from(data);
       this.log(LogLevel.INFO, `📥 RSP ${response[0]}:`, response.slice(1, args.length + 2));
 
       if (response[0] !== cmd) {
@@ -120,17 +232,22 @@ export class KeyboardHID {
     }
   }
 
-  public reconnect() {
-    this.log(LogLevel.INFO, 'Attempting to reconnect...');
-    if (this.device) {
+  async close() {
+    const device = this.device ?? await this.opening?.catch(() => null);
+    this.device = null;
+    if (device) {
       try {
-        this.device.close();
+        await device.close();
       } catch (e: unknown) {
         this.log(LogLevel.ERROR, 'Error closing existing device:', e);
       }
-      this.device = null;
     }
-    this.connect();
+  }
+
+  public async reconnect() {
+    this.log(LogLevel.INFO, 'Attempting to reconnect...');
+    await this.close();
+    await this.connect();
   }
 
   async setSkadisMode(enabled: boolean) {
@@ -148,8 +265,9 @@ export class KeyboardHID {
     return response[1];
   }
 
-  async setRGBColor(h: number, s: number, v: number) {
-    const response = await this.sendCommandWithResponse(0x04, h, s, v);
+  // persist = false skips the EEPROM write, for colors streamed many times a second
+  async setRGBColor(h: number, s: number, v: number, persist = true) {
+    const response = await this.sendCommandWithResponse(0x04, h, s, v, persist ? 0 : 1);
     return {
       hue: response[1],
       saturation: response[2],
@@ -164,8 +282,6 @@ export class KeyboardHID {
   }
 
   async getCurrentState() {
-    if (!this.device) throw new Error('No device connected');
-    
     try {
       const response = await this.sendCommandWithResponse(0x0F);
       
@@ -197,7 +313,7 @@ export class KeyboardHID {
   // Add method to ensure connection
   async ensureConnection() {
     if (!await this.validateConnection()) {
-      this.reconnect();
+      await this.reconnect();
       if (!await this.validateConnection()) {
         throw new Error('Failed to establish connection with keyboard');
       }
@@ -222,4 +338,105 @@ export class KeyboardHID {
       patch: response[3]
     };
   }
+
+  async getMemStats(): Promise<MemStats> {
+    const response = await this.sendCommandWithResponse(KeyboardHID.CMD_GET_MEM_STATS);
+    const u16 = (i: number) => response[i] | (response[i + 1] << 8);
+    return {
+      ramSize: u16(1),
+      dataSize: u16(3),
+      bssSize: u16(5),
+      stackSize: u16(7),
+      stackPeak: u16(9),
+      stackNow: u16(11)
+    };
+  }
+
+  async setIdleTimeouts(timeouts: IdleTimeouts): Promise<IdleTimeouts> {
+    const response = await this.sendCommandWithResponse(
+      KeyboardHID.CMD_SET_IDLE_TIMEOUTS,
+      timeouts.dim & 0xFF, timeouts.dim >> 8,
+      timeouts.freeze & 0xFF, timeouts.freeze >> 8,
+      timeouts.off & 0xFF, timeouts.off >> 8
+    );
+    const u16 = (i: number) => response[i] | (response[i + 1] << 8);
+    return { dim: u16(1), freeze: u16(3), off: u16(5) };
+  }
+
+  // One request per timer; the first also reports how many timers there are
+  async getSchedStats(): Promise<SchedStats> {
+    const timers: SchedTimerStats[] = [];
+    let count = 1;
+    let pending = 0;
+
+    for (let id = 0; id < count; id++) {
+      const response = await this.sendCommandWithResponse(KeyboardHID.CMD_GET_SCHED_STATS, id);
+      const u16 = (i: number) => response[i] | (response[i + 1] << 8);
+      const u32 = (i: number) => (u16(i) + u16(i + 2) * 0x10000);
+      count = response[1];
+      pending = response[2];
+      if (id < count) {
+        timers.push({
+          name: SCHED_TIMERS[id] ?? `timer ${id}`,
+          dispatches: u32(3),
+          totalLateMs: u32(7),
+          maxLateMs: u16(11)
+        });
+      }
+    }
+    return { timers, pending };
+  }
+
+  // Switches the layer color theme; persist stores the choice in EEPROM
+  async setTheme(index: number, persist = false) {
+    const response = await this.sendCommandWithResponse(KeyboardHID.CMD_SET_THEME, index, persist ? 1 : 0);
+    return {
+      theme: response[1],
+      count: response[2]
+    };
+  }
+
+  /*
+   * Stores a custom theme in the board's EEPROM, or erases it when layers is
+   * null. Layers left out keep their current color. Returns the theme index
+   * to select it with setTheme.
+   */
+  async setCustomTheme(layers: CustomTheme | null) {
+    const args = [layers ? 1 : 0, 0, 0];
+    if (layers) {
+      let mask = 0;
+      THEME_LAYERS.forEach((name, i) => {
+        const hsv = layers[name];
+        if (hsv) mask |= 1 << i;
+        args.push(...(hsv ?? [0, 0, 0]));
+      });
+      args[1] = mask & 0xFF;
+      args[2] = mask >> 8;
+    }
+
+    const response = await this.sendCommandWithResponse(KeyboardHID.CMD_SET_CUSTOM_THEME, ...args);
+    if (layers && response[3] !== THEME_LAYERS.length) {
+      throw new Error(`Firmware has ${response[3]} theme layers, expected ${THEME_LAYERS.length}`);
+    }
+    return {
+      stored: Boolean(response[1]),
+      theme: response[2]
+    };
+  }
+
+  async getIdleStats(): Promise<IdleStats> {
+    const response = await this.sendCommandWithResponse(KeyboardHID.CMD_GET_IDLE_STATS);
+    const u16 = (i: number) => response[i] | (response[i + 1] << 8);
+    const u32 = (i: number) => (u16(i) + u16(i + 2) * 0x10000);
+    return {
+      stage: IDLE_STAGES[response[1]] ?? 'active',
+      timeouts: { dim: u16(2), freeze: u16(4), off: u16(6) },
+      seconds: {
+        active: u32(8),
+        dim: u32(12),
+        frozen: u32(16),
+        off: u32(20)
+      }
+    };
+  }
 } 
\ No newline at end of file
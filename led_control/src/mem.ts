@@ -0,0 +1,129 @@
+import { execFileSync } from 'child_process';
+import { readFileSync } from 'fs';
+import { MemStats } from './hid/keyboard.js';
+
+export interface FeatureUsage {
+  feature: string;
+  data: number;
+  bss: number;
+}
+
+// Source paths, used when the ELF carries debug info (avr-nm -l). First match wins.
+const PATH_PATTERNS: [RegExp, string][] = [
+  [/keymaps\//, 'keymap'],
+  [/rgblight|ws2812/, 'rgblight'],
+  [/os_detection/, 'os_detection'],
+  [/caps_word/, 'caps_word'],
+  [/mousekey/, 'mousekey'],
+  [/encoder/, 'encoder'],
+  [/raw_hid/, 'raw_hid'],
+  [/report\.c|host\.c/, 'nkro/report'],
+  [/protocol\/|lufa|usb_/, 'usb'],
+  [/eeconfig|eeprom/, 'eeprom'],
+  [/avr-libc|libgcc|crt\w*\./, 'runtime'],
+];
+
+/*
+ * Symbol names, for everything else. The board is built with LTO, so the
+ * linker map only shows ltrans objects and the symbol name is the most
+ * reliable trace of where a variable came from.
+ */
+const SYMBOL_PATTERNS: [RegExp, string][] = [
+  // This keymap's own statics (keymap.c, sched.c, idle_governor.c, mem_stats.c)
+  [/^(keymaps|encoder_map|user_config|theme_custom|skadis_mode|white_mode|is_mac_mode|manual_os_override|app_switcher_\w+|stack_low|scan_timer|idle_timer|stage\w*|last_activity|saved|head|next_deadline|armed|stats|pending_count)$/, 'keymap'],
+  [/^(rgblight|ws2812|led$|animation_status|static_effect_table|mode_base_table|effect_)/, 'rgblight'],
+  [/^(os_detection|detected_os|reported_os|usb_setups|setups_data|stored_os)/, 'os_detection'],
+  [/^caps_word/, 'caps_word'],
+  [/^(mousekey|mouse_report|mk_)/, 'mousekey'],
+  [/^encoder/, 'encoder'],
+  [/^raw_hid/, 'raw_hid'],
+  [/^(keyboard_report|nkro|keyboard_protocol|keyboard_idle|keymap_config)/, 'nkro/report'],
+  [/^(USB_|Endpoint_|usb_|CDC_|HID_|console_|vusb_|keyboard_led_state)/, 'usb'],
+  [/^(eeconfig|eeprom)/, 'eeprom'],
+  [/^(matrix|raw_matrix|debounce|last_key|layer_state|default_layer_state|action_|tapping_|weak_mods|real_mods|oneshot_)/, 'core'],
+  [/^(__|_end$|errno)/, 'runtime'],
+];
+
+// One line of `avr-nm -S`: address, size, type, name, then the source location with -l
+const NM_LINE = /^([0-9a-f]+)\s+([0-9a-f]+)\s+([a-z])\s+(\S+)(?:\s+(\S.*))?$/i;
+
+function featureFor(symbol: string, source?: string): string {
+  if (source) {
+    for (const [pattern, feature] of PATH_PATTERNS) {
+      if (pattern.test(source)) return feature;
+    }
+  }
+  // Static variables get suffixes like name.lto_priv.0 or name.1234 from the compiler
+  const name = symbol.replace(/\.(lto_priv\.)?\d+$/, '');
+  for (const [pattern, feature] of SYMBOL_PATTERNS) {
+    if (pattern.test(name)) return feature;
+  }
+  return 'other';
+}
+
+function readSymbols(path: string): string {
+  if (!path.endsWith('.elf')) {
+    return readFileSync(path, 'utf8');
+  }
+  try {
+    return execFileSync('avr-nm', ['-S', '-l', '--size-sort', path], { encoding: 'utf8', maxBuffer: 16 * 1024 * 1024 });
+  } catch (e) {
+    throw new Error(`Could not run avr-nm on ${path}: ${e instanceof Error ? e.message : e}`);
+  }
+}
+
+/*
+ * Groups static SRAM usage by feature from the firmware's symbol table:
+ * either the ELF written by the QMK build (.build/cockpit_default.elf, read
+ * with avr-nm) or a saved `avr-nm -S -l` listing of it.
+ */
+export function parseSymbols(path: string): FeatureUsage[] {
+  const usage = new Map<string, FeatureUsage>();
+
+  for (const line of readSymbols(path).split(/\r?\n/)) {
+    const match = NM_LINE.exec(line.trim());
+    if (!match) continue;
+
+    // d/D initialised data (which includes rodata on AVR), b/B zeroed or noinit
+    const type = match[3].toLowerCase();
+    if (type !== 'd' && type !== 'b') continue;
+
+    const size = parseInt(match[2], 16);
+    if (size === 0) continue;
+
+    const feature = featureFor(match[4], match[5]);
+    const entry = usage.get(feature) ?? { feature, data: 0, bss: 0 };
+    if (type === 'd') {
+      entry.data += size;
+    } else {
+      entry.bss += size;
+    }
+    usage.set(feature, entry);
+  }
+
+  return [...usage.values()].sort((a, b) => (b.data + b.bss) - (a.data + a.bss));
+}
+
+export function formatMemReport(stats: MemStats, features?: FeatureUsage[]): string {
+  const pad = (n: number) => String(n).padStart(6);
+  const headroom = stats.stackSize - stats.stackPeak;
+  const lines = [
+    `SRAM        ${pad(stats.ramSize)} B`,
+    `  .data     ${pad(stats.dataSize)} B`,
+    `  .bss      ${pad(stats.bssSize)} B`,
+    `  stack     ${pad(stats.stackSize)} B available`,
+    `    peak    ${pad(stats.stackPeak)} B`,
+    `    now     ${pad(stats.stackNow)} B`,
+    `  headroom  ${pad(headroom)} B (${((headroom / stats.ramSize) * 100).toFixed(1)}% of SRAM)`,
+  ];
+
+  if (features && features.length > 0) {
+    lines.push('', 'Static usage by feature (from symbol table):');
+    lines.push(`  ${'feature'.padEnd(24)} ${'.data'.padStart(6)} ${'.bss'.padStart(6)}`);
+    for (const f of features) {
+      lines.push(`  ${f.feature.padEnd(24)} ${pad(f.data)} ${pad(f.bss)}`);
+    }
+  }
+
+  return lines.join('\n');
+}
@@ -3,7 +3,7 @@ import { render, Box, Text, useInput } from "ink";
 import SelectInput from "ink-select-input";
 import Spinner from "ink-spinner";
 import TextInput from "ink-text-input";
-import { KeyboardHID, Version } from "./hid/keyboard.js";
+import { KeyboardHID, KeyboardSelector, Version } from "./hid/keyboard.js";
 
 // Add these to package.json dependencies:
 // "ink-select-input": "^5.0.0",
@@ -355,8 +355,8 @@ const ColorWheel = ({
   );
 };
 
-const App = () => {
-  const [kb] = useState(() => new KeyboardHID());
+const App = ({ selector }: { selector: KeyboardSelector }) => {
+  const [kb] = useState(() => new KeyboardHID(selector));
   const [selectedEffect, setSelectedEffect] = useState(0);
   const [h, setH] = useState(0);
   const [s, setS] = useState(255);
@@ -703,6 +703,6 @@ const App = () => {
   );
 };
 
-export const startUI = () => {
-  render(<App />);
+export const startUI = (selector: KeyboardSelector = {}) => {
+  render(<App selector={selector} />);
 };